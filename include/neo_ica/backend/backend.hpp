@@ -14,6 +14,7 @@
 #include "blas.h"
 #include "lapack.h"
 #include "umintl/backends/f77blas.hpp"
+#include "neo_ica/tools/profiler.h"
 
 
 namespace neo_ica{
@@ -28,6 +29,20 @@ struct umintl_backend{
     typedef typename umintl::backend::blas_types<ScalarType> type;
 };
 
+namespace detail{
+
+    //Nominal operation counts used by the profiler
+    inline uint64_t gemm_flops(std::ptrdiff_t M, std::ptrdiff_t N, std::ptrdiff_t K)
+    { return 2*(uint64_t)M*N*K; }
+    inline uint64_t gemm_bytes(std::ptrdiff_t M, std::ptrdiff_t N, std::ptrdiff_t K, bool beta, size_t size)
+    { return ((uint64_t)M*K + (uint64_t)K*N + (uint64_t)M*N*(beta?2:1))*size; }
+    inline uint64_t cube(std::ptrdiff_t n)
+    { return (uint64_t)n*n*n; }
+    inline uint64_t square(std::ptrdiff_t n)
+    { return (uint64_t)n*n; }
+
+}
+
 
 template<class _ScalarType>
 struct backend;
@@ -41,9 +56,11 @@ struct backend<float>{
 
 
     static void getrf(size_t m, size_t n, ptr_type a, size_t lda, size_t* ipiv)
-    {   sgetrf(&m,&n,a,&lda,(size_t*)ipiv,&dummy_info);    }
+    {   tools::scoped_phase phase(tools::PHASE_GETRF, 2*detail::square(n)*sizeof(ScalarType), 2*detail::cube(n)/3);
+        sgetrf(&m,&n,a,&lda,(size_t*)ipiv,&dummy_info);    }
     static void getri(size_t n, ptr_type A, size_t lda, size_t* ipiv)
     {
+        tools::scoped_phase phase(tools::PHASE_GETRI, 2*detail::square(n)*sizeof(ScalarType), 4*detail::cube(n)/3);
         size_t lwork = -1;
         ScalarType* work = new ScalarType;
         sgetri(&n, A, &lda, ipiv, work, &lwork, &dummy_info);
@@ -54,9 +71,11 @@ struct backend<float>{
         delete[] work;
     }
     static void gemm(char TransA, char TransB, size_t M, size_t N, size_t K , ScalarType alpha, cst_ptr_type A, size_t lda, cst_ptr_type B, size_t ldb, ScalarType beta, ptr_type C, size_t ldc)
-    {   sgemm(&TransA,&TransB,&M,&N,&K,&alpha,(ptr_type)A,&lda,(ptr_type)B,&ldb,&beta,C,&ldc); }
+    {   tools::scoped_phase phase(tools::PHASE_GEMM, detail::gemm_bytes(M,N,K,beta!=0,sizeof(ScalarType)), detail::gemm_flops(M,N,K));
+        sgemm(&TransA,&TransB,&M,&N,&K,&alpha,(ptr_type)A,&lda,(ptr_type)B,&ldb,&beta,C,&ldc); }
     static void syev(char jobz, char uplo, size_t n,  ScalarType* a, size_t lda, ScalarType* w )
     {
+        tools::scoped_phase phase(tools::PHASE_SYEV, 2*detail::square(n)*sizeof(ScalarType), ((jobz=='V')?9:4)*detail::cube(n)/3);
         size_t lwork = -1;
         ScalarType* work = new ScalarType;
         ssyev(&jobz,&uplo, &n, a, &lda, w, work, &lwork, &dummy_info );
@@ -77,9 +96,11 @@ struct backend<double>{
     typedef std::ptrdiff_t size_t;
 
     static void getrf(size_t m, size_t n, ptr_type a, size_t lda, size_t* ipiv)
-    {   dgetrf(&m,&n,a,&lda,(size_t*)ipiv,&dummy_info);    }
+    {   tools::scoped_phase phase(tools::PHASE_GETRF, 2*detail::square(n)*sizeof(ScalarType), 2*detail::cube(n)/3);
+        dgetrf(&m,&n,a,&lda,(size_t*)ipiv,&dummy_info);    }
     static void getri(size_t n, ptr_type A, size_t lda, size_t* ipiv)
     {
+        tools::scoped_phase phase(tools::PHASE_GETRI, 2*detail::square(n)*sizeof(ScalarType), 4*detail::cube(n)/3);
         size_t lwork = -1;
         ScalarType* work = (ScalarType *) malloc(sizeof(ScalarType) * 1);
         dgetri(&n, A, &lda, ipiv, work, &lwork, &dummy_info);
@@ -90,9 +111,11 @@ struct backend<double>{
         free(work);
     }
     static void gemm(char TransA, char TransB, size_t M, size_t N, size_t K , ScalarType alpha, cst_ptr_type A, size_t lda, cst_ptr_type B, size_t ldb, ScalarType beta, ptr_type C, size_t ldc)
-    {   dgemm(&TransA,&TransB,&M,&N,&K,&alpha,(ptr_type)A,&lda,(ptr_type)B,&ldb,&beta,C,&ldc); }
+    {   tools::scoped_phase phase(tools::PHASE_GEMM, detail::gemm_bytes(M,N,K,beta!=0,sizeof(ScalarType)), detail::gemm_flops(M,N,K));
+        dgemm(&TransA,&TransB,&M,&N,&K,&alpha,(ptr_type)A,&lda,(ptr_type)B,&ldb,&beta,C,&ldc); }
     static void syev(char jobz, char uplo, size_t n,  ScalarType* a, size_t lda, ScalarType* w )
     {
+        tools::scoped_phase phase(tools::PHASE_SYEV, 2*detail::square(n)*sizeof(ScalarType), ((jobz=='V')?9:4)*detail::cube(n)/3);
         size_t lwork = -1;
         ScalarType* work = new ScalarType;
         dsyev(&jobz,&uplo, &n, a, &lda, w, work, &lwork, &dummy_info );
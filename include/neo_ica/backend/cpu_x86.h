@@ -61,6 +61,7 @@ public:
     bool HW_FMA3;
     bool HW_FMA4;
     bool HW_AVX2;
+    bool HW_F16C;
 
     //  SIMD: 512-bit
     bool HW_AVX512_F;
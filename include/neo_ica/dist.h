@@ -14,8 +14,11 @@
 #include <stdint.h>
 #include <immintrin.h>
 
+#include "neo_ica/tools/layout.hpp"
+
 namespace neo_ica{
 
+//Scalar functions use libm, vector functions the transcendentals of the accuracy tier M (see math.h)
 #define DECLARE_NONLINEARITY(NAME) \
     template<class T>\
     struct NAME\
@@ -24,9 +27,9 @@ namespace neo_ica{
         inline static T phi(T z, T k);\
         inline static T dphi(T z, T k);\
 \
-        inline static __m128 logp(__m128 const &  z, __m128 const &  k);\
-        inline static __m128 phi(__m128 const &  z, __m128 const &  k);\
-        inline static __m128 dphi(__m128 const & z, __m128 const &  k);\
+        template<class M> inline static __m128 logp(__m128 const &  z, __m128 const &  k);\
+        template<class M> inline static __m128 phi(__m128 const &  z, __m128 const &  k);\
+        template<class M> inline static __m128 dphi(__m128 const & z, __m128 const &  k);\
     }
 
 DECLARE_NONLINEARITY(infomax);
@@ -35,20 +38,31 @@ DECLARE_NONLINEARITY(extended_infomax);
 template<class T>
 class dist_base{
 public:
-    dist_base(int64_t NC, int64_t NF) : NC_(NC), NF_(NF){}
+    dist_base(int64_t NC, int64_t NF, accuracy_tier accuracy) : NC_(NC), NF_(NF), accuracy_(accuracy){}
     virtual void mu(int64_t offset, int64_t sample_size, T * z1, T* signs, T * mu) const = 0;
     virtual void phi(int64_t offset, int64_t sample_size, T * z1, T* signs, T* phi) const = 0;
     virtual void dphi(int64_t offset, int64_t sample_size, T * z1, T* signs, T* dphi) const = 0;
 
+    /* Fused kernels for small numbers of channels, over the frames [offset, offset+sample_size) of the data X
+     * in any of its layouts and storages. Z = X*W (and RZ = X*V) is formed a few frames at a time in registers
+     * and never stored. value_gradient computes mu and phixT = X'*phi(Z), hv_product psixT = X'*(dphi(Z).*RZ).
+     * They return false, leaving the outputs untouched, when no fused kernel applies (see has_fused_kernels) */
+    virtual bool fused_value_gradient(tools::whitened_data<T> const & X, int64_t offset, int64_t sample_size, T const * W, T const * signs, T * mu, T * phixT) const = 0;
+    virtual bool fused_hv_product(tools::whitened_data<T> const & X, int64_t offset, int64_t sample_size, T const * W, T const * V, T const * signs, T * psixT) const = 0;
+    //Same nonlinearity and accuracy over NC channels, e.g. a subset of the components
+    virtual dist_base<T>* subset(int64_t NC) const = 0;
+
 protected:
     int64_t NC_;
     int64_t NF_;
+    accuracy_tier accuracy_;
 };
 
 template<class T, template<class> class F>
 class dist: public dist_base<T>{
     using dist_base<T>::NC_;
     using dist_base<T>::NF_;
+    using dist_base<T>::accuracy_;
 
 private:
     //Fallback
@@ -61,12 +75,19 @@ private:
     void dphi_sse3(int64_t offset, int64_t sample_size, T * z1, T* signs, T* dphi) const;
 
 public:
-    dist(int64_t NC, int64_t NF) : dist_base<T>(NC, NF){}
+    dist(int64_t NC, int64_t NF, accuracy_tier accuracy = dflt::accuracy) : dist_base<T>(NC, NF, accuracy){}
     void mu(int64_t offset, int64_t sample_size, T * z1, T* signs, T * mu) const;
     void phi(int64_t offset, int64_t sample_size, T * z1, T* signs, T* phi) const;
     void dphi(int64_t offset, int64_t sample_size, T * z1, T* signs, T* dphi) const;
+    bool fused_value_gradient(tools::whitened_data<T> const & X, int64_t offset, int64_t sample_size, T const * W, T const * signs, T * mu, T * phixT) const;
+    bool fused_hv_product(tools::whitened_data<T> const & X, int64_t offset, int64_t sample_size, T const * W, T const * V, T const * signs, T * psixT) const;
+    dist_base<T>* subset(int64_t NC) const { return new dist<T, F>(NC, NF_, accuracy_); }
 };
 
+//Whether the fused kernels apply to NC channels in the precision T on this CPU
+template<class T>
+bool has_fused_kernels(int64_t NC);
+
 }
 
 
@@ -16,6 +16,28 @@
 
 namespace neo_ica{
 
+//Precision in which the whitened data is kept
+enum storage_type{
+    //That of the computations, single or double
+    STORAGE_NATIVE,
+    //IEEE half precision (needs F16C) : 11 significant bits, up to 65504
+    STORAGE_FP16,
+    //bfloat16 : 8 significant bits, the range of single precision
+    STORAGE_BF16
+};
+
+/* Accuracy of the transcendentals (tanh, log(1 + e^x)) of the nonlinearities. Errors are against double
+ * precision, over all single precision inputs */
+enum accuracy_tier{
+    //libm, element by element in the precision of the data : at most 2.2 ULP in single precision
+    ACCURACY_EXACT,
+    //fmath exp and log, in single precision : at most 38 ULP for |x| >= 1/16, but absolute errors of up to
+    //2e-7 for tanh near 0 and 5e-7 for log(1 + e^x) when x < -17, where the relative error is unbounded
+    ACCURACY_FMATH,
+    //Pade approximant of tanh, without exp, in single precision : at most 1616 ULP (relative error 1e-4, near
+    //|x| = 5), 3.3 ULP for |x| < 1/16. log(1 + e^x) is that of the fmath tier
+    ACCURACY_FAST
+};
 
 namespace dflt{
     static const size_t iter = 500;
@@ -26,6 +48,26 @@ namespace dflt{
     static const int nthreads = 0;
     static const double tol = 1e-5;
     static const bool extended = true;
+    static const bool profile = false;
+    static const bool hardware_counters = false;
+    static const size_t max_memory = 0;
+    static const bool huge_pages = true;
+    static const bool prefault = true;
+    static const bool pin_threads = false;
+    static const bool pipeline = false;
+    static const bool fused_kernels = false;
+    static const bool frame_blocked = false;
+    static const storage_type storage = STORAGE_NATIVE;
+    static const bool mixed_precision = false;
+    static const double escalation = 10;
+    static const accuracy_tier accuracy = ACCURACY_FMATH;
+    static const double freeze_tol = 0;
+    static const size_t freeze_period = 10;
+    static const bool adaptive_sampling = false;
+    static const bool early_exit = false;
+    static const bool importance_sampling = false;
+    static const double coreset_fraction = 0;
+    static const size_t coreset_polish = 10;
 }
 
 struct options{
@@ -38,7 +80,15 @@ struct options{
             bool _extended = dflt::extended,
             double _tol = dflt::tol):
         iter(_iter), verbose(_verbose), theta(_theta), rho(_rho),
-        fbatch(_fbatch), nthreads(_nthreads), extended(_extended), tol(_tol){}
+        fbatch(_fbatch), nthreads(_nthreads), extended(_extended), tol(_tol),
+        profile(dflt::profile), hardware_counters(dflt::hardware_counters), max_memory(dflt::max_memory),
+        huge_pages(dflt::huge_pages), prefault(dflt::prefault), pin_threads(dflt::pin_threads), pipeline(dflt::pipeline),
+        fused_kernels(dflt::fused_kernels), frame_blocked(dflt::frame_blocked), storage(dflt::storage),
+        mixed_precision(dflt::mixed_precision), escalation(dflt::escalation), accuracy(dflt::accuracy),
+        freeze_tol(dflt::freeze_tol), freeze_period(dflt::freeze_period),
+        adaptive_sampling(dflt::adaptive_sampling), early_exit(dflt::early_exit),
+        importance_sampling(dflt::importance_sampling), coreset_fraction(dflt::coreset_fraction),
+        coreset_polish(dflt::coreset_polish){}
 
     size_t iter;
     unsigned int verbose;
@@ -48,6 +98,46 @@ struct options{
     int nthreads;
     bool extended;
     double tol;
+    //Per-phase timings, bytes and FLOPs dumped as JSON to profile_file (stdout if empty)
+    bool profile;
+    std::string profile_file;
+    //Adds cycles, instructions and LLC misses of each kernel to the profile (Linux perf_event_open)
+    bool hardware_counters;
+    //Chrome/Perfetto timeline of the optimizer phases, recorded only when non-empty
+    std::string trace_file;
+    //Upper bound in bytes on the buffers allocated by ica(), 0 for none
+    size_t max_memory;
+    //Backs the large buffers with transparent huge pages (madvise)
+    bool huge_pages;
+    //Touches the large buffers when allocating them rather than in the first iteration
+    bool prefault;
+    //Pins the threads of the pool to one CPU each, NUMA node by node
+    bool pin_threads;
+    //Overlaps the projections of the tiles with the nonlinearities of the previous ones
+    bool pipeline;
+    //Fused one-pass kernels for the gradient and the Hv products, in single precision with at most 32 channels
+    bool fused_kernels;
+    //Stores the whitened data by blocks of 16 frames for the fused kernels, ignored without them
+    bool frame_blocked;
+    //Keeps the whitened data in 16 bits for the fused kernels, ignored without them
+    storage_type storage;
+    //Double precision only : optimizes in single precision down to escalation*tol, then refines in double
+    bool mixed_precision;
+    double escalation;
+    //Accuracy tier of the nonlinearities, for the whole run
+    accuracy_tier accuracy;
+    //Freezes the components whose gradient norm is below freeze_tol (0 for none), rechecked every freeze_period iterations
+    double freeze_tol;
+    size_t freeze_period;
+    //Tunes rho and theta during the run to the measured decrease of the objective per second
+    bool adaptive_sampling;
+    //Gives up a trial step of the line search as soon as the frames read show that it fails the sufficient decrease
+    bool early_exit;
+    //Samples the frames by strata of their score |phi(z)|*|x|, reweighted to keep the estimates unbiased
+    bool importance_sampling;
+    //Optimizes first on a coreset of about coreset_fraction*NF frames (0 for none), then coreset_polish iterations on all
+    double coreset_fraction;
+    size_t coreset_polish;
 };
 
 template<class ScalarType>
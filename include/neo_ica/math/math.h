@@ -10,6 +10,7 @@
 #ifndef NEOICA_MATH_H
 #define NEOICA_MATH_H
 
+#include <cmath>
 #include <pmmintrin.h>
 #include "fmath.hpp"
 
@@ -73,6 +74,71 @@ inline __m128 log_1pe(__m128 x)
     return xifpos + log(_1 + exp(xneg));
 }
 
+/*
+ * ---------------------------
+ * Fast tier
+ * ---------------------------
+ */
+
+//Coefficients of the [7/6] Pade approximant of tanh
+static const __m128 tanh_clamp = _mm_set1_ps(4.9725f);
+static const __m128 tanh_c0 = _mm_set1_ps(135135.f);
+static const __m128 tanh_p2 = _mm_set1_ps(17325.f);
+static const __m128 tanh_p4 = _mm_set1_ps(378.f);
+static const __m128 tanh_q2 = _mm_set1_ps(62370.f);
+static const __m128 tanh_q4 = _mm_set1_ps(3150.f);
+static const __m128 tanh_q6 = _mm_set1_ps(28.f);
+
+//tanh : x(135135 + 17325x^2 + 378x^4 + x^6)/(135135 + 62370x^2 + 3150x^4 + 28x^6), a convergent of Lambert's
+//continued fraction, on [-4.9725, 4.9725] where it reaches +-1. No exp, one division
+inline __m128 fast_tanh(__m128 x){
+    x = _mm_max_ps(_mm_min_ps(x, tanh_clamp), _mm_sub_ps(_mm_setzero_ps(), tanh_clamp));
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_add_ps(x2, tanh_p4);
+    p = _mm_add_ps(_mm_mul_ps(p, x2), tanh_p2);
+    p = _mm_add_ps(_mm_mul_ps(p, x2), tanh_c0);
+    p = _mm_mul_ps(p, x);
+    __m128 q = _mm_add_ps(_mm_mul_ps(tanh_q6, x2), tanh_q4);
+    q = _mm_add_ps(_mm_mul_ps(q, x2), tanh_q2);
+    q = _mm_add_ps(_mm_mul_ps(q, x2), tanh_c0);
+    return _mm_div_ps(p, q);
+}
+
+/*
+ * Vector transcendentals of the accuracy tiers (see neo_ica::accuracy_tier), used as policies by the
+ * nonlinearities. Tiles of the exact tier are evaluated element by element in the precision of the data;
+ * its vector functions, lane by lane with libm, only serve single precision
+ */
+struct exact_tier{
+    static const bool per_element = true;
+    static __m128 tanh(__m128 x){
+        float v[4];
+        _mm_storeu_ps(v, x);
+        for(int i = 0 ; i < 4 ; ++i)
+            v[i] = std::tanh(v[i]);
+        return _mm_loadu_ps(v);
+    }
+    static __m128 log_1pe(__m128 x){
+        float v[4];
+        _mm_storeu_ps(v, x);
+        for(int i = 0 ; i < 4 ; ++i)
+            v[i] = ((v[i]>0)?v[i]:0) + std::log1p(std::exp(-std::abs(v[i])));
+        return _mm_loadu_ps(v);
+    }
+};
+
+struct fmath_tier{
+    static const bool per_element = false;
+    static __m128 tanh(__m128 x) { return math::tanh(x); }
+    static __m128 log_1pe(__m128 x) { return math::log_1pe(x); }
+};
+
+struct fast_tier{
+    static const bool per_element = false;
+    static __m128 tanh(__m128 x) { return fast_tanh(x); }
+    static __m128 log_1pe(__m128 x) { return math::log_1pe(x); }
+};
+
 //sigmoid
 template<class T>
 inline T sigmoid(T x)
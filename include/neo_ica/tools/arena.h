@@ -0,0 +1,106 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_ARENA_H_
+#define NEO_ICA_TOOLS_ARENA_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "neo_ica/tools/memory.h"
+#include "neo_ica/tools/round.hpp"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+//Alignment of every arena allocation : one cache line, hence also an SSE/AVX vector
+static const size_t arena_alignment = 64;
+
+//Number of elements of a row padded so that consecutive rows stay aligned
+template<class T>
+int64_t padded_size(int64_t n)
+{ return round_to_next_multiple<int64_t>(n, arena_alignment/sizeof(T)); }
+
+/* Allocator of the large buffers (data, objective and shuffle scratch). Allocations are aligned on
+ * arena_alignment, optionally backed by transparent huge pages (madvise) and pre-faulted by all
+ * the workers of the thread pool so that the first iteration does not pay the page faults. Pre-faulting is the
+ * NUMA first touch : each row is split into the frame ranges of thread_frame_range, so the pages of
+ * a thread's frames land on its node */
+class arena{
+private:
+    arena() : huge_pages_(true), prefault_(true){ }
+    arena(arena const &);
+    arena& operator=(arena const &);
+
+public:
+    static arena & get();
+
+    void huge_pages(bool value) { huge_pages_ = value; }
+    bool huge_pages() const { return huge_pages_; }
+    void prefault(bool value) { prefault_ = value; }
+    bool prefault() const { return prefault_; }
+
+    //Throws a neo_ica::exception when out of memory. row_bytes is the size of the rows split
+    //between threads by the first touch (0 for a single row)
+    void* allocate(size_t bytes, memory_category category, size_t row_bytes = 0);
+    void release(void* ptr, size_t bytes, memory_category category);
+
+private:
+    bool huge_pages_;
+    bool prefault_;
+};
+
+/* RAII array allocated from the arena */
+template<class T>
+class buffer{
+private:
+    buffer(buffer const &);
+    buffer& operator=(buffer const &);
+
+public:
+    buffer() : ptr_(NULL), size_(0), category_(MEMORY_DATA){ }
+    buffer(size_t size, memory_category category) : ptr_(NULL), size_(0), category_(category)
+    { allocate(size, category); }
+    buffer(size_t rows, size_t ld, memory_category category) : ptr_(NULL), size_(0), category_(category)
+    { allocate(rows, ld, category); }
+    ~buffer(){ reset(); }
+
+    void allocate(size_t size, memory_category category)
+    { allocate(1, size, category); }
+
+    //rows*ld matrix, each row being partitioned by frames between the threads on first touch
+    void allocate(size_t rows, size_t ld, memory_category category){
+        reset();
+        ptr_ = static_cast<T*>(arena::get().allocate(rows*ld*sizeof(T), category, ld*sizeof(T)));
+        size_ = rows*ld;
+        category_ = category;
+    }
+
+    void reset(){
+        if(ptr_)
+            arena::get().release(ptr_, size_*sizeof(T), category_);
+        ptr_ = NULL;
+        size_ = 0;
+    }
+
+    T* get() const { return ptr_; }
+    size_t size() const { return size_; }
+
+private:
+    T* ptr_;
+    size_t size_;
+    memory_category category_;
+};
+
+}
+}
+
+#endif
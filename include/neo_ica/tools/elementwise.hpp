@@ -0,0 +1,100 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_ELEMENTWISE_HPP_
+#define NEO_ICA_TOOLS_ELEMENTWISE_HPP_
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "neo_ica/tools/arena.h"
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/simd.hpp"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/*
+ * Elementwise operations on NC rows (channels) of n frames, each row at a stride of ld. The frames are split
+ * among the workers of the pool as in the first touch of the data, and each row is swept with SSE registers
+ * of T. Small operands, or calls from within a parallel region, run on the calling thread
+ */
+
+//Elements below which a loop is not worth a parallel region
+static const int64_t elementwise_parallel_threshold = 1 << 15;
+
+template<class T, class F>
+void for_each_frame_range(int64_t NC, int64_t n, F const & f){
+    if(NC*n < elementwise_parallel_threshold)
+        f((int64_t)0, n);
+    else
+        parallel_for(0, n, arena_alignment/sizeof(T), f);
+}
+
+//res = a.*b
+template<class T>
+void multiply(int64_t NC, int64_t n, T const * a, int64_t lda, T const * b, int64_t ldb, T * res, int64_t ldres){
+    typedef packed<T> P;
+    for_each_frame_range<T>(NC, n, [&](int64_t begin, int64_t end){
+        for(int64_t c = 0 ; c < NC ; ++c){
+            T const * pa = a + c*lda;
+            T const * pb = b + c*ldb;
+            T * pres = res + c*ldres;
+            int64_t f = begin;
+            for(; f + P::size <= end ; f += P::size)
+                P::store(pres + f, P::mul(P::load(pa + f), P::load(pb + f)));
+            for(; f < end ; ++f)
+                pres[f] = pa[f]*pb[f];
+        }
+    });
+}
+
+//res = a.^2
+template<class T>
+void square(int64_t NC, int64_t n, T const * a, int64_t lda, T * res, int64_t ldres){
+    typedef packed<T> P;
+    for_each_frame_range<T>(NC, n, [&](int64_t begin, int64_t end){
+        for(int64_t c = 0 ; c < NC ; ++c){
+            T const * pa = a + c*lda;
+            T * pres = res + c*ldres;
+            int64_t f = begin;
+            for(; f + P::size <= end ; f += P::size){
+                typename P::type x = P::load(pa + f);
+                P::store(pres + f, P::mul(x, x));
+            }
+            for(; f < end ; ++f)
+                pres[f] = pa[f]*pa[f];
+        }
+    });
+}
+
+//a(c,:) += alpha*x[c]
+template<class T>
+void add_to_rows(int64_t NC, int64_t n, T * a, int64_t lda, T const * x, T alpha){
+    typedef packed<T> P;
+    for_each_frame_range<T>(NC, n, [&](int64_t begin, int64_t end){
+        for(int64_t c = 0 ; c < NC ; ++c){
+            T * pa = a + c*lda;
+            T shift = alpha*x[c];
+            typename P::type vshift = P::set1(shift);
+            int64_t f = begin;
+            for(; f + P::size <= end ; f += P::size)
+                P::store(pa + f, P::add(P::load(pa + f), vshift));
+            for(; f < end ; ++f)
+                pa[f] += shift;
+        }
+    });
+}
+
+}
+}
+
+#endif
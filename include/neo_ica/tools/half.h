@@ -0,0 +1,45 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_HALF_H_
+#define NEO_ICA_TOOLS_HALF_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "neo_ica/ica.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/*
+ * Conversions between single precision and the 16-bit storage types. IEEE half precision uses F16C, bfloat16
+ * (the upper half of a float, rounded to nearest even) only needs SSE. Values out of the half precision range
+ * saturate to infinity
+ */
+
+//Whether the host can convert from and to the given storage
+bool storage_supported(storage_type storage);
+//Bytes per element, 0 for the native storage
+size_t storage_size(storage_type storage);
+const char* storage_name(storage_type storage);
+
+void widen(storage_type storage, uint16_t const * in, int64_t n, float * out);
+void narrow(storage_type storage, float const * in, int64_t n, uint16_t * out);
+
+//Double precision goes through single precision
+void widen(storage_type storage, uint16_t const * in, int64_t n, double * out);
+void narrow(storage_type storage, double const * in, int64_t n, uint16_t * out);
+
+}
+}
+
+#endif
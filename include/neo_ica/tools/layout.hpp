@@ -0,0 +1,152 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_LAYOUT_HPP_
+#define NEO_ICA_TOOLS_LAYOUT_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+#include "neo_ica/ica.h"
+#include "neo_ica/tools/elementwise.hpp"
+#include "neo_ica/tools/half.h"
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/round.hpp"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/*
+ * Frame-blocked layout of NC channels : the frames are grouped in blocks of frame_block, each block holding
+ * its frames channel after channel, so that (c, f) is at (f/frame_block)*NC*frame_block + c*frame_block +
+ * f%frame_block. A window of frames is then one contiguous range of memory, rather than NC ranges NF apart,
+ * and a block is an NC*frame_block channel-major matrix with a leading dimension of frame_block. The last
+ * block is zero-padded
+ */
+
+//One cache line of each channel in single precision, two AVX vectors
+static const int64_t frame_block = 16;
+
+inline int64_t blocked_frames(int64_t NF)
+{ return round_to_next_multiple<int64_t>(NF, frame_block); }
+
+inline int64_t blocked_offset(int64_t NC, int64_t c, int64_t f)
+{ return (f/frame_block)*NC*frame_block + c*frame_block + f%frame_block; }
+
+/* Whitened data of NC channels and NF frames as stored : channel-major (rows of NF frames) or frame-blocked,
+ * in the precision T of the computations or in one of the 16-bit storages. Rows are read and written a run
+ * of frames at a time, converted from and to T */
+template<class T>
+struct whitened_data{
+    whitened_data(void * data, int64_t NC, int64_t NF, bool blocked, storage_type storage) : data(data), NC(NC), NF(NF), blocked(blocked), storage(storage){ }
+
+    //Channel-major in T, hence usable in place by the GEMMs
+    bool direct() const { return !blocked && storage==STORAGE_NATIVE; }
+    T const * native() const { return static_cast<T const *>(data); }
+    uint16_t const * compact() const { return static_cast<uint16_t const *>(data); }
+
+    //Frames stored per channel, padding included
+    int64_t frames() const { return blocked?blocked_frames(NF):NF; }
+    size_t element_size() const { return (storage==STORAGE_NATIVE)?sizeof(T):storage_size(storage); }
+    uint64_t bytes() const { return (uint64_t)NC*frames()*element_size(); }
+
+    int64_t offset(int64_t c, int64_t f) const
+    { return blocked?blocked_offset(NC, c, f):c*NF + f; }
+
+    //out = frames [f, f+n) of the channel c
+    void read(int64_t c, int64_t f, int64_t n, T * out) const{
+        for(int64_t end = f + n ; f < end ; ){
+            int64_t count = blocked?std::min(end - f, frame_block - f%frame_block):end - f;
+            if(storage==STORAGE_NATIVE)
+                std::copy(native() + offset(c, f), native() + offset(c, f) + count, out);
+            else
+                widen(storage, compact() + offset(c, f), count, out);
+            out += count;
+            f += count;
+        }
+    }
+
+    //Frames [f, f+n) of the channel c = in
+    void write(int64_t c, int64_t f, int64_t n, T const * in) const{
+        for(int64_t end = f + n ; f < end ; ){
+            int64_t count = blocked?std::min(end - f, frame_block - f%frame_block):end - f;
+            if(storage==STORAGE_NATIVE)
+                std::copy(in, in + count, static_cast<T *>(data) + offset(c, f));
+            else
+                narrow(storage, in, count, static_cast<uint16_t *>(data) + offset(c, f));
+            in += count;
+            f += count;
+        }
+    }
+
+    T at(int64_t c, int64_t f) const{
+        T res;
+        read(c, f, 1, &res);
+        return res;
+    }
+
+    //Copies the frames [t, t+n) into NC rows of out, at a stride of ld
+    void unpack(int64_t t, int64_t n, T * out, int64_t ld) const{
+        for_each_frame_range<T>(NC, n, [&](int64_t begin, int64_t end){
+            for(int64_t c = 0 ; c < NC ; ++c)
+                read(c, t + begin, end - begin, out + c*ld + begin);
+        });
+    }
+
+    void * data;
+    int64_t NC;
+    int64_t NF;
+    bool blocked;
+    storage_type storage;
+};
+
+//Frames converted at once by a worker of convert
+static const int64_t convert_chunk = 256;
+
+//Copies the frames of from into to, of the same size, across precisions, layouts and storages. Padding is zeroed
+template<class S, class T>
+void convert(whitened_data<S> const & from, whitened_data<T> const & to){
+    parallel_for(0, to.frames(), convert_chunk, [&](int64_t begin, int64_t end){
+        std::vector<S> in(convert_chunk);
+        std::vector<T> out(convert_chunk);
+        for(int64_t t = begin ; t < end ; t += convert_chunk){
+            int64_t ns = std::min(convert_chunk, end - t);
+            int64_t valid = std::max<int64_t>(0, std::min(ns, from.NF - t));
+            for(int64_t c = 0 ; c < to.NC ; ++c){
+                from.read(c, t, valid, in.data());
+                std::copy(in.begin(), in.begin() + valid, out.begin());
+                std::fill(out.begin() + valid, out.begin() + ns, 0);
+                to.write(c, t, ns, out.data());
+            }
+        }
+    });
+}
+
+//Reorders the frames of data in place : frame f becomes the frame perm[f] of the previous order. Channel by channel
+template<class T>
+void permute(whitened_data<T> const & data, int64_t const * perm){
+    parallel_for(0, data.NC, 1, [&](int64_t begin, int64_t end){
+        std::vector<T> in(data.NF), out(data.NF);
+        for(int64_t c = begin ; c < end ; ++c){
+            data.read(c, 0, data.NF, in.data());
+            for(int64_t f = 0 ; f < data.NF ; ++f)
+                out[f] = in[perm[f]];
+            data.write(c, 0, data.NF, out.data());
+        }
+    });
+}
+
+}
+}
+
+#endif
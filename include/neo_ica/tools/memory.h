@@ -0,0 +1,87 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_MEMORY_H_
+#define NEO_ICA_TOOLS_MEMORY_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <ostream>
+
+namespace neo_ica
+{
+namespace tools
+{
+
+enum memory_category{
+    //Whitened data
+    MEMORY_DATA,
+    //NC*tile buffers of the objective function
+    MEMORY_OBJECTIVE,
+    //Permutation and scratch row of the shuffle
+    MEMORY_SHUFFLE,
+    //NC*NC matrices
+    MEMORY_PARAMETERS,
+    N_MEMORY_CATEGORIES
+};
+
+const char* memory_category_name(memory_category category);
+
+/* Process-wide accounting of the large buffers allocated by ica(), with per-category peaks */
+class memory_tracker{
+private:
+    memory_tracker(){ reset(); }
+    memory_tracker(memory_tracker const &);
+    memory_tracker& operator=(memory_tracker const &);
+
+public:
+    static memory_tracker & get();
+
+    void reset();
+    void allocate(memory_category category, uint64_t bytes);
+    void release(memory_category category, uint64_t bytes);
+
+    uint64_t current(memory_category category) const { return current_[category]; }
+    uint64_t peak(memory_category category) const { return peak_[category]; }
+    //Peak of the sum of all categories, which is not the sum of the peaks
+    uint64_t peak() const { return peak_total_; }
+
+    void print(std::ostream & os) const;
+    void to_json(std::ostream & os) const;
+
+private:
+    uint64_t current_[N_MEMORY_CATEGORIES];
+    uint64_t peak_[N_MEMORY_CATEGORIES];
+    uint64_t current_total_;
+    uint64_t peak_total_;
+};
+
+/* Sizes of the objective function buffers */
+struct memory_plan{
+    //Number of frames processed per tile by the objective function
+    int64_t tile;
+    //Leading dimension of the tile buffers, padded to the arena alignment
+    int64_t ld;
+    //Whether the squared data is precomputed once, rather than for each tile into a reused buffer
+    bool cache_squares;
+    //Whether dphi(X*W) over the window of the Hessian-vector products is kept from one product to the next
+    bool cache_curvature;
+    //Predicted peak usage
+    uint64_t peak;
+};
+
+/* Picks the largest tile that keeps the peak usage of ica() under max_memory (0 for no limit), for data
+ * stored channel-major or frame-blocked, in scalars of scalar_size or of storage_size bytes (0 for the former).
+ * Throws a neo_ica::exception when even the smallest tile does not fit */
+memory_plan plan_memory(int64_t NC, int64_t NF, size_t scalar_size, uint64_t max_memory, bool frame_blocked, size_t storage_size);
+
+}
+}
+
+#endif
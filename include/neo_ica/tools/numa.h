@@ -0,0 +1,54 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_NUMA_H_
+#define NEO_ICA_TOOLS_NUMA_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/* Range [begin, end) of the frames [off, off+NS) owned by thread tid out of nthreads. Boundaries are
+ * multiples of granularity relative to off. The same partition is used by the first-touch initialization
+ * of the arena and by the kernels, so that each thread mostly reads pages it placed itself */
+void thread_frame_range(int64_t off, int64_t NS, int64_t granularity, int tid, int nthreads, int64_t & begin, int64_t & end);
+
+/* CPUs of each NUMA node (Linux sysfs), restricted to the CPUs the process may run on. A single node
+ * holding every allowed CPU when the topology is unknown */
+struct numa_topology{
+    static numa_topology const & get();
+    std::vector< std::vector<int> > nodes;
+};
+
+/* Pins the workers of the thread pool to one CPU each, filling the NUMA nodes in order so that consecutive
+ * workers, hence consecutive frame ranges, share a node. The previous affinities are restored on destruction */
+class scoped_thread_affinity{
+private:
+    scoped_thread_affinity(scoped_thread_affinity const &);
+    scoped_thread_affinity& operator=(scoped_thread_affinity const &);
+
+public:
+    explicit scoped_thread_affinity(bool enabled);
+    ~scoped_thread_affinity();
+    bool pinned() const { return pinned_; }
+
+private:
+    bool pinned_;
+    std::vector< std::vector<int> > previous_;
+};
+
+}
+}
+
+#endif
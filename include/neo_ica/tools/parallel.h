@@ -0,0 +1,100 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_PARALLEL_H_
+#define NEO_ICA_TOOLS_PARALLEL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "neo_ica/tools/numa.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/* Persistent pool running all the parallel loops of the library. The calling thread is worker 0 and
+ * the other workers are started once. Between regions, idle workers spin for a short while before
+ * parking on a condition variable, so they stay warm across the many short regions of one optimization
+ * step (minibatch kernels) without holding a core once ica() is done. Starting and joining a region
+ * costs a couple of atomic operations when the workers are spinning */
+class thread_pool{
+private:
+    thread_pool();
+    thread_pool(thread_pool const &);
+    thread_pool& operator=(thread_pool const &);
+
+public:
+    static thread_pool & get();
+    ~thread_pool();
+
+    //Number of workers, the caller included
+    void resize(int nthreads);
+    int size() const { return (int)workers_.size() + 1; }
+
+    //Runs f(tid, nthreads) on every worker and returns once all of them are done. Regions started from
+    //within a region, or while another thread uses the pool, run on the calling thread only
+    template<class F>
+    void run(F const & f)
+    { run(&invoke<F>, &f); }
+
+    //Worker index of the calling thread, 0 outside of the pool
+    static int current_thread();
+    //Whether the calling thread is running a region
+    static bool in_parallel_region();
+
+private:
+    template<class F>
+    static void invoke(void const * f, int tid, int nthreads)
+    { (*static_cast<F const *>(f))(tid, nthreads); }
+
+    void run(void (*fn)(void const *, int, int), void const * arg);
+    void work(int tid, uint64_t seen);
+    void stop();
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_;
+
+    //Current region, published by bumping generation_
+    void (*fn_)(void const *, int, int);
+    void const * arg_;
+    std::atomic<uint64_t> generation_;
+    std::atomic<int> pending_;
+    std::atomic<int> parked_;
+    std::atomic<bool> stop_;
+    std::mutex park_mutex_;
+    std::condition_variable park_cv_;
+};
+
+/* Runs f(tid, nthreads) on every worker of the pool */
+template<class F>
+void parallel_run(F const & f)
+{ thread_pool::get().run(f); }
+
+/* Runs f(begin, end) on every worker over its thread_frame_range of [off, off+N) */
+template<class F>
+void parallel_for(int64_t off, int64_t N, int64_t granularity, F const & f){
+    thread_pool::get().run([&](int tid, int nthreads){
+        int64_t begin, end;
+        thread_frame_range(off, N, granularity, tid, nthreads, begin, end);
+        if(begin < end)
+            f(begin, end);
+    });
+}
+
+}
+}
+
+#endif
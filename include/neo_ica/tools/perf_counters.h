@@ -0,0 +1,69 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_PERF_COUNTERS_H_
+#define NEO_ICA_TOOLS_PERF_COUNTERS_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace neo_ica
+{
+namespace tools
+{
+
+enum hardware_event{
+    HW_CYCLES,
+    HW_INSTRUCTIONS,
+    HW_LLC_REFERENCES,
+    HW_LLC_MISSES,
+    N_HW_EVENTS
+};
+
+const char* hardware_event_name(hardware_event event);
+
+/* Hardware performance counters (Linux perf_event_open), opened on every worker of the thread pool.
+ * Threads spawned by the BLAS library are not counted. When the counters cannot be opened (kernel.perf_event_paranoid,
+ * containers, non-Linux hosts), the counters are simply disabled and status() says why */
+class hardware_counters{
+private:
+    hardware_counters() : enabled_(false), status_("closed"){
+        for(int e = 0 ; e < N_HW_EVENTS ; ++e)
+            available_[e] = false;
+    }
+    hardware_counters(hardware_counters const &);
+    hardware_counters& operator=(hardware_counters const &);
+
+public:
+    static hardware_counters & get();
+
+    //Returns whether at least one event could be opened
+    bool open();
+    void close();
+
+    bool enabled() const { return enabled_; }
+    bool available(hardware_event event) const { return available_[event]; }
+    std::string const & status() const { return status_; }
+
+    //Current value of each event, summed over threads and scaled for multiplexing
+    void read(uint64_t* values) const;
+
+private:
+    bool enabled_;
+    bool available_[N_HW_EVENTS];
+    std::string status_;
+    std::vector<int> fds_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,141 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_PIPELINE_H_
+#define NEO_ICA_TOOLS_PIPELINE_H_
+
+#include <immintrin.h>
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/tracer.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/* Bounded lock-free multi-producer multi-consumer queue of integers (Vyukov's sequence-numbered ring).
+ * push fails when the queue is full and pop when it is empty, neither ever blocks */
+class bounded_queue{
+private:
+    bounded_queue(bounded_queue const &);
+    bounded_queue& operator=(bounded_queue const &);
+
+    struct cell{
+        std::atomic<uint64_t> sequence;
+        int64_t value;
+    };
+
+    //Producers and consumers only share the cells
+    struct alignas(64) position{
+        std::atomic<uint64_t> value;
+    };
+
+public:
+    //The capacity is rounded up to a power of two
+    explicit bounded_queue(size_t capacity);
+    ~bounded_queue();
+
+    bool push(int64_t value);
+    bool pop(int64_t & value);
+
+private:
+    cell* cells_;
+    uint64_t mask_;
+    position enqueue_;
+    position dequeue_;
+};
+
+/* Two-stage pipeline over n_items work items on the thread pool. An item is produced into one of n_slots
+ * buffers, then consumed from it; the ready queue hands items from the first stage to the second and the
+ * free queue hands the slots back, so that at most n_slots items are in flight. The first half of the
+ * workers produce and the others consume, and a worker helps the other stage rather than wait : a producer
+ * with no free slot consumes, a consumer with nothing ready produces. Without workers to spare, items are
+ * produced and consumed in order on the calling thread */
+class pipeline{
+private:
+    pipeline(pipeline const &);
+    pipeline& operator=(pipeline const &);
+
+public:
+    pipeline(int64_t n_items, int n_slots);
+
+    //produce(item, slot, tid) and consume(item, slot, tid) on every worker, returns once all items are consumed
+    template<class Produce, class Consume>
+    void run(Produce const & produce, Consume const & consume){
+        parallel_run([&](int tid, int nthreads){
+            if(nthreads < 2){
+                for(int64_t item = 0 ; item < n_items_ ; ++item){
+                    produce(item, 0, tid);
+                    consume(item, 0, tid);
+                }
+                return;
+            }
+            scoped_span span("pipeline_worker");
+            bool producer = tid < nthreads/2;
+            int idle = 0;
+            while(consumed_.load(std::memory_order_acquire) < n_items_){
+                bool progress = producer?(try_produce(produce, tid) || try_consume(consume, tid))
+                                        :(try_consume(consume, tid) || try_produce(produce, tid));
+                //Yields now and then for oversubscribed hosts
+                if(progress)
+                    idle = 0;
+                else if(++idle%64==0)
+                    std::this_thread::yield();
+                else
+                    _mm_pause();
+            }
+        });
+    }
+
+private:
+    template<class Produce>
+    bool try_produce(Produce const & produce, int tid){
+        if(next_.load(std::memory_order_relaxed) >= n_items_)
+            return false;
+        int64_t slot;
+        if(!free_.pop(slot))
+            return false;
+        int64_t item = next_.fetch_add(1, std::memory_order_relaxed);
+        if(item >= n_items_){
+            free_.push(slot);
+            return false;
+        }
+        produce(item, (int)slot, tid);
+        //Never full : there are as many cells as slots
+        ready_.push(item*n_slots_ + slot);
+        return true;
+    }
+
+    template<class Consume>
+    bool try_consume(Consume const & consume, int tid){
+        int64_t entry;
+        if(!ready_.pop(entry))
+            return false;
+        consume(entry/n_slots_, (int)(entry%n_slots_), tid);
+        free_.push(entry%n_slots_);
+        consumed_.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    int64_t n_items_;
+    int n_slots_;
+    bounded_queue free_;
+    bounded_queue ready_;
+    std::atomic<int64_t> next_;
+    std::atomic<int64_t> consumed_;
+};
+
+}
+}
+
+#endif
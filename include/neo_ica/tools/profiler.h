@@ -0,0 +1,196 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_PROFILER_H_
+#define NEO_ICA_TOOLS_PROFILER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+#include "neo_ica/tools/perf_counters.h"
+#include "neo_ica/tools/tracer.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/*
+ * Phases are either kernels or optimizer stages, which are inclusive of the kernels they call.
+ * Kernels may nest (the pipeline and the reductions wrap the GEMMs and element-wise kernels they
+ * run on the calling thread) : their self time excludes the nested kernels, so that the self times
+ * of the kernels add up to the time spent in kernels.
+ */
+enum phase_type{
+    //Kernels
+    PHASE_GEMM,
+    PHASE_GETRF,
+    PHASE_GETRI,
+    PHASE_SYEV,
+    PHASE_DIST_MU,
+    PHASE_DIST_PHI,
+    PHASE_DIST_DPHI,
+    PHASE_ELEMENTWISE,
+    //Producer/consumer evaluation of the tiles, inclusive of the kernels run by its workers
+    PHASE_PIPELINE,
+    //Fused projection, nonlinearity and accumulation of the small-NC kernels
+    PHASE_FUSED,
+    //Tall-skinny X'*Y split over the workers, inclusive of their GEMMs
+    PHASE_REDUCTION,
+    //Stages
+    PHASE_VALUE_GRADIENT,
+    PHASE_HV_PRODUCT,
+    PHASE_GRADIENT_VARIANCE,
+    PHASE_HV_PRODUCT_VARIANCE,
+    PHASE_LINE_SEARCH,
+    PHASE_CONJUGATE_GRADIENT,
+    PHASE_WHITEN,
+    PHASE_SHUFFLE,
+    PHASE_STRATIFY,
+    N_PHASES
+};
+
+const char* phase_name(phase_type phase);
+bool is_kernel(phase_type phase);
+
+struct phase_counters{
+    phase_counters() : calls(0), nanoseconds(0), self_nanoseconds(0), bytes(0), flops(0), hardware_samples(0){
+        for(int e = 0 ; e < N_HW_EVENTS ; ++e)
+            hardware[e] = 0;
+    }
+    uint64_t calls;
+    uint64_t nanoseconds;
+    //Excluding the nested kernels
+    uint64_t self_nanoseconds;
+    uint64_t bytes;
+    uint64_t flops;
+    //Hardware events, only accumulated for kernels
+    uint64_t hardware_samples;
+    uint64_t hardware[N_HW_EVENTS];
+};
+
+/* Process-wide accumulator of per-phase wall time, calls, bytes touched and FLOPs.
+ * Disabled by default; phases are only recorded outside of parallel regions */
+class profiler{
+private:
+    profiler() : enabled_(false){}
+    profiler(profiler const &);
+    profiler& operator=(profiler const &);
+
+public:
+    static profiler & get();
+
+    bool enabled() const { return enabled_; }
+    void enable(bool value) { enabled_ = value; }
+    void reset();
+
+    void add(phase_type phase, uint64_t nanoseconds, uint64_t bytes, uint64_t flops, uint64_t nested = 0){
+        phase_counters & c = counters_[phase];
+        c.calls++;
+        c.nanoseconds += nanoseconds;
+        c.self_nanoseconds += nanoseconds - std::min(nested, nanoseconds);
+        c.bytes += bytes;
+        c.flops += flops;
+    }
+
+    void add_hardware(phase_type phase, uint64_t const * begin, uint64_t const * end){
+        phase_counters & c = counters_[phase];
+        c.hardware_samples++;
+        for(int e = 0 ; e < N_HW_EVENTS ; ++e)
+            c.hardware[e] += (end[e] > begin[e])?end[e] - begin[e]:0;
+    }
+
+    //Kernels open on the calling thread : closing one returns the time of the kernels nested in it
+    void open_kernel() { nested_.push_back(0); }
+    uint64_t close_kernel(uint64_t nanoseconds){
+        uint64_t nested = nested_.back();
+        nested_.pop_back();
+        if(!nested_.empty())
+            nested_.back() += nanoseconds;
+        return nested;
+    }
+
+    phase_counters const & operator[](phase_type phase) const { return counters_[phase]; }
+
+    void to_json(std::ostream & os) const;
+
+private:
+    bool enabled_;
+    phase_counters counters_[N_PHASES];
+    //Time of the kernels nested in each open kernel, innermost last
+    std::vector<uint64_t> nested_;
+};
+
+/* Records the lifetime of the object into the given phase when profiling is enabled,
+ * and as a span of the calling thread when tracing is enabled.
+ * Phases opened inside a parallel region are traced but not profiled.
+ * Hardware counters, when opened, are read around kernels only */
+class scoped_phase{
+    typedef std::chrono::steady_clock clock;
+public:
+    scoped_phase(phase_type phase, uint64_t bytes = 0, uint64_t flops = 0) :
+        phase_(phase), bytes_(bytes), flops_(flops), arg_name_(NULL), arg_(0),
+        profiled_(profiler::get().enabled() && !in_parallel_region()), traced_(tracer::get().enabled()),
+        sampled_(profiled_ && is_kernel(phase) && hardware_counters::get().enabled()){
+        if(profiled_ && is_kernel(phase_))
+            profiler::get().open_kernel();
+        if(sampled_)
+            hardware_counters::get().read(hardware_);
+        if(profiled_)
+            start_ = clock::now();
+        if(traced_)
+            begin_ = tracer::get().now();
+    }
+
+    //Attaches an integer argument (e.g., the sample size) to the trace span
+    void annotate(const char* name, int64_t value){
+        arg_name_ = name;
+        arg_ = value;
+    }
+
+    ~scoped_phase(){
+        if(profiled_){
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start_).count();
+            uint64_t nested = is_kernel(phase_)?profiler::get().close_kernel(ns):0;
+            profiler::get().add(phase_, ns, bytes_, flops_, nested);
+        }
+        if(sampled_){
+            uint64_t end[N_HW_EVENTS];
+            hardware_counters::get().read(end);
+            profiler::get().add_hardware(phase_, hardware_, end);
+        }
+        if(traced_)
+            tracer::get().record(current_thread(), phase_name(phase_), begin_, tracer::get().now(), arg_name_, arg_);
+    }
+
+private:
+    scoped_phase(scoped_phase const &);
+    scoped_phase& operator=(scoped_phase const &);
+
+    phase_type phase_;
+    uint64_t bytes_;
+    uint64_t flops_;
+    const char* arg_name_;
+    int64_t arg_;
+    bool profiled_;
+    bool traced_;
+    bool sampled_;
+    uint64_t hardware_[N_HW_EVENTS];
+    clock::time_point start_;
+    int64_t begin_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,96 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_REDUCTION_HPP_
+#define NEO_ICA_TOOLS_REDUCTION_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+#include "neo_ica/backend/backend.hpp"
+#include "neo_ica/tools/arena.h"
+#include "neo_ica/tools/numa.h"
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/profiler.h"
+#include "neo_ica/tools/threads.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+//Frames per worker below which the reduction is left to the BLAS library
+static const int64_t reduction_min_frames = 4096;
+
+/*
+ * Tall-skinny product C = alpha*A'*B + beta*C, with A (n*M) and B (n*N) stored channel-major (rows of n
+ * frames at strides lda and ldb) and C an M*N column-major matrix. The inner dimension is huge and the
+ * output tiny, which most BLAS libraries split poorly : here A holds the frames [offset, offset+n) of
+ * rows of lda frames, and each worker of the pool takes those of its first-touch range of the rows
+ * (thread_frame_range over [0, lda)), so that it reads the pages it placed. Each worker issues one
+ * single-threaded GEMM into its private M*N sum, and the sums are added pairwise along a fixed binary tree
+ * (worker i takes in worker i+s, for s = 1, 2, 4...). The result hence only depends on the number of
+ * workers, not on their timing. Small operands, windows within the range of a single worker, or calls from
+ * within a parallel region, use one GEMM on the calling thread
+ */
+template<class T>
+void tall_skinny_product(int64_t M, int64_t N, int64_t n, T alpha, T const * A, int64_t lda, T const * B, int64_t ldb, T beta, T * C, int64_t offset = 0){
+    int nthreads = thread_pool::get().size();
+    int64_t granularity = arena_alignment/sizeof(T);
+    int busy = 0;
+    for(int tid = 0 ; tid < nthreads && n >= 2*reduction_min_frames ; ++tid){
+        int64_t begin, end;
+        thread_frame_range(0, lda, granularity, tid, nthreads, begin, end);
+        busy += std::max(begin, offset) < std::min(end, offset + n);
+    }
+    if(busy < 2 || thread_pool::in_parallel_region()){
+        backend<T>::gemm(Trans,NoTrans,M,N,n,alpha,A,lda,B,ldb,beta,C,M);
+        return;
+    }
+
+    scoped_phase phase(PHASE_REDUCTION, detail::gemm_bytes(M,N,n,beta!=0,sizeof(T)), detail::gemm_flops(M,N,n) + (uint64_t)nthreads*M*N);
+    int64_t size = M*N;
+    //Sums of the workers left without frames stay zero
+    std::vector<T> partial(nthreads*size, 0);
+    {
+        //The workers issue their own GEMMs
+        scoped_blas_threads blas(1);
+        parallel_run([&](int tid, int pool_size){
+            int64_t begin, end;
+            if(pool_size==nthreads){
+                thread_frame_range(0, lda, granularity, tid, nthreads, begin, end);
+                begin = std::max(begin, offset) - offset;
+                end = std::min(end, offset + n) - offset;
+            }
+            //Fewer workers than expected : they split the window evenly
+            else
+                thread_frame_range(0, n, granularity, tid, pool_size, begin, end);
+            if(begin < end)
+                backend<T>::gemm(Trans,NoTrans,M,N,end-begin,1,A+begin,lda,B+begin,ldb,0,&partial[tid*size],M);
+        });
+    }
+
+    for(int s = 1 ; s < nthreads ; s *= 2)
+        for(int tid = 0 ; tid + s < nthreads ; tid += 2*s){
+            T * sum = &partial[tid*size];
+            T const * other = &partial[(tid+s)*size];
+            for(int64_t i = 0 ; i < size ; ++i)
+                sum[i] += other[i];
+        }
+
+    for(int64_t i = 0 ; i < size ; ++i)
+        C[i] = alpha*partial[i] + ((beta==0)?0:beta*C[i]);
+}
+
+}
+}
+
+#endif
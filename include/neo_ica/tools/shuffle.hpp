@@ -13,14 +13,13 @@
 #include <cstddef>
 #include <random>
 
+#include "neo_ica/tools/arena.h"
+
 namespace neo_ica
 {
 
-template<class ScalarType>
-void shuffle(ScalarType* data, size_t NC, size_t NF){
-    size_t* perms = new size_t[NF];
-    ScalarType * shuffled_va = new ScalarType[NF];
-
+//Frame f of the shuffled data is frame perms[f] of the original data
+inline void shuffle_permutation(size_t NF, size_t* perms){
     std::minstd_rand gen(0);
     for(size_t i = 0 ; i < NF ; ++i)
         perms[i] = i;
@@ -28,15 +27,22 @@ void shuffle(ScalarType* data, size_t NC, size_t NF){
         size_t j = std::uniform_int_distribution<size_t>(i, NF-1)(gen);
         std::swap(perms[i], perms[j]);
     }
+}
+
+template<class ScalarType>
+void shuffle(ScalarType* data, size_t NC, size_t NF){
+    tools::buffer<size_t> perms_buffer(NF, tools::MEMORY_SHUFFLE);
+    tools::buffer<ScalarType> shuffled_va_buffer(NF, tools::MEMORY_SHUFFLE);
+    size_t* perms = perms_buffer.get();
+    ScalarType * shuffled_va = shuffled_va_buffer.get();
+
+    shuffle_permutation(NF, perms);
     for(size_t c = 0 ; c < NC ; ++c){
         for(size_t f = 0 ; f < NF ; ++f)
             shuffled_va[f] = data[c*NF+perms[f]];
         for(size_t f = 0 ; f < NF ; ++f)
             data[c*NF+f] = shuffled_va[f];
     }
-
-    delete[] shuffled_va;
-    delete[] perms;
 }
 
 }
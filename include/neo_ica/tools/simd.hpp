@@ -2,6 +2,7 @@
 #define NEO_ICA_TOOLS_SIMD_HPP_
 
 #include <cstddef>
+#include <stdint.h>
 #include <immintrin.h>
 
 namespace neo_ica
@@ -13,11 +14,11 @@ template<class T>
 __m128 load_cast_f32(T* ptr);
 
 template<>
-__m128 load_cast_f32<float>(float* ptr)
+inline __m128 load_cast_f32<float>(float* ptr)
 { return _mm_loadu_ps(ptr); }
 
 template<>
-__m128 load_cast_f32<double>(double* ptr)
+inline __m128 load_cast_f32<double>(double* ptr)
 {
     __m128d xlo = _mm_loadu_pd(ptr);
     __m128d xhi = _mm_loadu_pd(ptr + 2);
@@ -25,20 +26,79 @@ __m128 load_cast_f32<double>(double* ptr)
     return x;
 }
 
+template<class T>
+__m128 load_cast_f32_aligned(T* ptr);
+
+template<>
+inline __m128 load_cast_f32_aligned<float>(float* ptr)
+{ return _mm_load_ps(ptr); }
+
+template<>
+inline __m128 load_cast_f32_aligned<double>(double* ptr)
+{
+    __m128d xlo = _mm_load_pd(ptr);
+    __m128d xhi = _mm_load_pd(ptr + 2);
+    __m128 x = _mm_movelh_ps(_mm_cvtpd_ps(xlo), _mm_cvtpd_ps(xhi));
+    return x;
+}
+
 template<class T>
 void cast_f32_store(T* ptr, __m128 x);
 
 template<>
-void cast_f32_store<float>(float* ptr, __m128 x)
+inline void cast_f32_store<float>(float* ptr, __m128 x)
 { _mm_storeu_ps(ptr,x); }
 
 template<>
-void cast_f32_store<double>(double* ptr, __m128 x)
+inline void cast_f32_store<double>(double* ptr, __m128 x)
 {
     _mm_storeu_pd(ptr,_mm_cvtps_pd(x));
     _mm_storeu_pd(ptr+2,_mm_cvtps_pd(_mm_movehl_ps(x,x)));
 }
 
+template<class T>
+void cast_f32_store_aligned(T* ptr, __m128 x);
+
+template<>
+inline void cast_f32_store_aligned<float>(float* ptr, __m128 x)
+{ _mm_store_ps(ptr,x); }
+
+template<>
+inline void cast_f32_store_aligned<double>(double* ptr, __m128 x)
+{
+    _mm_store_pd(ptr,_mm_cvtps_pd(x));
+    _mm_store_pd(ptr+2,_mm_cvtps_pd(_mm_movehl_ps(x,x)));
+}
+
+inline bool is_aligned(void const * ptr, size_t alignment)
+{ return reinterpret_cast<uintptr_t>(ptr)%alignment==0; }
+
+/* SSE registers of T at full precision, for the arithmetic that must not go through float */
+template<class T>
+struct packed;
+
+template<>
+struct packed<float>{
+    typedef __m128 type;
+    static const int size = 4;
+    static type load(float const * ptr) { return _mm_loadu_ps(ptr); }
+    static void store(float * ptr, type x) { _mm_storeu_ps(ptr, x); }
+    static type set1(float x) { return _mm_set1_ps(x); }
+    static type add(type x, type y) { return _mm_add_ps(x, y); }
+    static type mul(type x, type y) { return _mm_mul_ps(x, y); }
+};
+
+template<>
+struct packed<double>{
+    typedef __m128d type;
+    static const int size = 2;
+    static type load(double const * ptr) { return _mm_loadu_pd(ptr); }
+    static void store(double * ptr, type x) { _mm_storeu_pd(ptr, x); }
+    static type set1(double x) { return _mm_set1_pd(x); }
+    static type add(type x, type y) { return _mm_add_pd(x, y); }
+    static type mul(type x, type y) { return _mm_mul_pd(x, y); }
+};
+
 }
 }
 
@@ -0,0 +1,79 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_THREADS_H_
+#define NEO_ICA_TOOLS_THREADS_H_
+
+#include <string>
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/* Thread-count hooks of the BLAS library linked in the process (OpenBLAS or MKL), looked up at
+ * runtime so that no particular implementation is required */
+struct blas_threading{
+    static blas_threading const & get();
+
+    //Name of the detected library, empty when none of the hooks is available
+    std::string library;
+    //Whether the BLAS threads are OpenMP threads, hence share the pool of the kernels
+    bool uses_openmp;
+
+    int get_num_threads() const;
+    bool set_num_threads(int nthreads) const;
+
+    int (*get_)();
+    void (*set_)(int);
+};
+
+/* Applies options.nthreads (0 for the runtime defaults) to the thread pool of the library, to OpenMP and
+ * to the BLAS library, so that the GEMMs and the kernels run with the same number of threads instead of
+ * oversubscribing. A BLAS library with its own thread pool is given the same budget : its threads and
+ * the workers alternate between phases rather than run concurrently. Restores the previous OpenMP and
+ * BLAS settings on destruction; the pool keeps its size and parks */
+class scoped_thread_budget{
+private:
+    scoped_thread_budget(scoped_thread_budget const &);
+    scoped_thread_budget& operator=(scoped_thread_budget const &);
+
+public:
+    explicit scoped_thread_budget(int nthreads);
+    ~scoped_thread_budget();
+
+    int threads() const { return threads_; }
+    std::string description() const;
+
+private:
+    int threads_;
+    int previous_omp_;
+    int previous_blas_;
+    bool previous_dynamic_;
+};
+
+/* Runs the BLAS library on the given number of threads for the lifetime of the object, e.g., one thread
+ * when the workers of the pool each issue their own small GEMMs */
+class scoped_blas_threads{
+private:
+    scoped_blas_threads(scoped_blas_threads const &);
+    scoped_blas_threads& operator=(scoped_blas_threads const &);
+
+public:
+    explicit scoped_blas_threads(int nthreads);
+    ~scoped_blas_threads();
+
+private:
+    int previous_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,70 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_TILE_SCHEDULER_H_
+#define NEO_ICA_TOOLS_TILE_SCHEDULER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+namespace neo_ica
+{
+namespace tools
+{
+
+/* Work-stealing schedule of the (channel, frame block) tiles of frames [off, off+NS). Tiles are numbered
+ * block-major, and each thread first takes the tiles of its own blocks (the thread_frame_range of the
+ * blocks, matching the first touch of the data), then steals from the other threads. All the cores are
+ * busy whatever the number of channels */
+class tile_scheduler{
+private:
+    tile_scheduler(tile_scheduler const &);
+    tile_scheduler& operator=(tile_scheduler const &);
+
+    //One cache line per queue, threads only contend when stealing
+    struct queue{
+        std::atomic<int64_t> next;
+        int64_t end;
+        char padding[64 - sizeof(std::atomic<int64_t>) - sizeof(int64_t)];
+    };
+
+public:
+    //granularity : frames per block are a multiple of it
+    tile_scheduler(int64_t NC, int64_t off, int64_t NS, int64_t granularity, int nthreads);
+    ~tile_scheduler();
+
+    int64_t n_tiles() const { return NC_*n_blocks_; }
+    int64_t n_blocks() const { return n_blocks_; }
+
+    //Next tile to process by thread tid, false once all the tiles are taken
+    bool next(int tid, int64_t & tile);
+
+    //Channel and frames [begin, end) of a tile
+    void tile(int64_t tile, int64_t & c, int64_t & begin, int64_t & end) const{
+        int64_t b = tile/NC_;
+        c = tile%NC_;
+        begin = off_ + b*block_;
+        end = (b+1==n_blocks_)?off_+NS_:begin+block_;
+    }
+
+private:
+    int64_t NC_;
+    int64_t off_;
+    int64_t NS_;
+    int64_t block_;
+    int64_t n_blocks_;
+    int nthreads_;
+    queue* queues_;
+};
+
+}
+}
+
+#endif
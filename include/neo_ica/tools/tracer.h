@@ -0,0 +1,98 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TOOLS_TRACER_H_
+#define NEO_ICA_TOOLS_TRACER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+namespace neo_ica
+{
+namespace tools
+{
+
+int current_thread();
+bool in_parallel_region();
+
+/* Process-wide recorder of nested spans, written in the Chrome/Perfetto trace-event format.
+ * Each worker of the thread pool records into its own buffer, so spans may be opened inside parallel regions */
+class tracer{
+    typedef std::chrono::steady_clock clock;
+
+    struct event{
+        const char* name;
+        const char* arg_name;
+        int64_t arg;
+        int64_t begin;
+        int64_t end;
+    };
+
+private:
+    tracer() : enabled_(false){}
+    tracer(tracer const &);
+    tracer& operator=(tracer const &);
+
+public:
+    static tracer & get();
+
+    bool enabled() const { return enabled_; }
+    //Enabling clears the previously recorded spans
+    void enable(bool value);
+
+    int64_t now() const
+    { return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - origin_).count(); }
+
+    void record(int tid, const char* name, int64_t begin, int64_t end, const char* arg_name = NULL, int64_t arg = 0){
+        if(tid < 0 || tid >= (int)events_.size())
+            return;
+        event e = {name, arg_name, arg, begin, end};
+        events_[tid].push_back(e);
+    }
+
+    void to_json(std::ostream & os) const;
+
+private:
+    bool enabled_;
+    clock::time_point origin_;
+    std::vector< std::vector<event> > events_;
+};
+
+/* Records the lifetime of the object as a span on the track of the calling thread */
+class scoped_span{
+public:
+    scoped_span(const char* name, const char* arg_name = NULL, int64_t arg = 0) :
+        name_(name), arg_name_(arg_name), arg_(arg), active_(tracer::get().enabled()){
+        if(active_)
+            begin_ = tracer::get().now();
+    }
+
+    ~scoped_span(){
+        if(active_)
+            tracer::get().record(current_thread(), name_, begin_, tracer::get().now(), arg_name_, arg_);
+    }
+
+private:
+    scoped_span(scoped_span const &);
+    scoped_span& operator=(scoped_span const &);
+
+    const char* name_;
+    const char* arg_name_;
+    int64_t arg_;
+    bool active_;
+    int64_t begin_;
+};
+
+}
+}
+
+#endif
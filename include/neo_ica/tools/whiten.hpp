@@ -9,6 +9,13 @@
 
 
 #include "neo_ica/backend/backend.hpp"
+#include "neo_ica/tools/elementwise.hpp"
+#include "neo_ica/tools/layout.hpp"
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/reduction.hpp"
+#include "neo_ica/tools/threads.h"
+#include <algorithm>
+#include <vector>
 #include <iostream>
 
 namespace neo_ica
@@ -43,52 +50,91 @@ namespace detail
 }
 
 template<class ScalarType>
-void compute_mean(ScalarType* A, int64_t NC, int64_t NF, ScalarType* x){
-    #pragma omp parallel for
-    for(int64_t c = 0 ; c < NC ;++c){
-        ScalarType sum = 0;
-        for(int64_t f = 0 ; f < NF ; ++f)
-            sum += A[c*NF+f];
-        x[c] = sum/(ScalarType)NF;
-    }
+void compute_mean(ScalarType* A, int64_t NC, int64_t NF, int64_t ld, ScalarType* x){
+    tools::parallel_for(0, NC, 1, [&](int64_t begin, int64_t end){
+        for(int64_t c = begin ; c < end ;++c){
+            ScalarType sum = 0;
+            for(int64_t f = 0 ; f < NF ; ++f)
+                sum += A[c*ld+f];
+            x[c] = sum/(ScalarType)NF;
+        }
+    });
 }
 
 
 
-template<class ScalarType>
-void whiten(int64_t NC, int64_t DataNF, int64_t NF, ScalarType const * cdata, ScalarType * Sphere, ScalarType * white_data){
-    ScalarType * Cov = new ScalarType[NC*NC];
-    ScalarType * means = new ScalarType[NC];
+namespace detail
+{
+
+    /* Sphere = inverse(sqrtm(Cov)) of the first NF frames. apply(data) is called while the data is centered
+     * in place, the means are added back afterwards */
+    template<class ScalarType, class Apply>
+    void sphere(int64_t NC, int64_t DataNF, int64_t NF, ScalarType const * cdata, ScalarType * Sphere, Apply const & apply){
+        ScalarType * Cov = new ScalarType[NC*NC];
+        ScalarType * means = new ScalarType[NC];
 
-    //We remove constness here to normalize the data (and add the mean back afterwards)
-    ScalarType * data = const_cast<ScalarType *>(cdata);
-    compute_mean(data,NC,NF,means);
+        //We remove constness here to normalize the data (and add the mean back afterwards)
+        ScalarType * data = const_cast<ScalarType *>(cdata);
+        compute_mean(data,NC,NF,DataNF,means);
 
-    //Substract mean
-    for(int64_t c = 0 ; c < NC ;++c)
-        for(int64_t f = 0 ; f < DataNF ; ++f)
-            data[c*DataNF+f] -= means[c];
+        //Substract mean
+        tools::add_to_rows<ScalarType>(NC,DataNF,data,DataNF,means,-1);
 
-    //Cov = 1/(N-1)*data_copy*data_copy'
-    ScalarType alpha = (ScalarType)(1)/(NF-1);
-    backend<ScalarType>::gemm(Trans,NoTrans,NC,NC,DataNF,alpha,data,DataNF,data,DataNF,0,Cov,NC);
+        //Cov = 1/(N-1)*data_copy*data_copy'
+        ScalarType alpha = (ScalarType)(1)/(NF-1);
+        tools::tall_skinny_product<ScalarType>(NC,NC,DataNF,alpha,data,DataNF,data,DataNF,0,Cov);
 
 
-    //Sphere = inverse(sqrtm(Cov))
-    detail::inv_sqrtm<ScalarType>(NC,Cov,Sphere);
-//    for(int64_t i = 0 ; i < NC*NC ;++i)
-//        Sphere[i]*=2;  Not sure why EEGLAB multiplies the sphere by 2
+        //Sphere = inverse(sqrtm(Cov))
+        detail::inv_sqrtm<ScalarType>(NC,Cov,Sphere);
+    //    for(int64_t i = 0 ; i < NC*NC ;++i)
+    //        Sphere[i]*=2;  Not sure why EEGLAB multiplies the sphere by 2
 
-    //white_data = sphere*data
-    backend<ScalarType>::gemm(NoTrans,NoTrans,NF,NC,NC,1,data,DataNF,Sphere,NC,0,white_data,NF);
+        apply(data);
 
-    //Readd mean
-    for(int64_t c = 0 ; c < NC ;++c)
-        for(int64_t f = 0 ; f < NF ; ++f)
-            data[c*DataNF+f] += means[c];
+        //Readd mean
+        tools::add_to_rows<ScalarType>(NC,DataNF,data,DataNF,means,1);
+
+        delete[] means;
+        delete[] Cov;
+    }
 
-    delete[] means;
-    delete[] Cov;
+}
+
+template<class ScalarType>
+void whiten(int64_t NC, int64_t DataNF, int64_t NF, ScalarType const * cdata, ScalarType * Sphere, ScalarType * white_data){
+    detail::sphere(NC, DataNF, NF, cdata, Sphere, [&](ScalarType const * data){
+        //white_data = sphere*data
+        backend<ScalarType>::gemm(NoTrans,NoTrans,NF,NC,NC,1,data,DataNF,Sphere,NC,0,white_data,NF);
+    });
+}
+
+//Frames gathered, whitened and scattered at once by a worker of whiten_shuffled
+static const int64_t whiten_chunk = 256;
+
+/* Whitens frame perms[f] of the data into frame f of white_data, in its layout and storage : the shuffle, the
+ * change of layout and the conversion are folded into the whitening, which writes the final data in one pass.
+ * Each worker gathers chunks of frames into a channel-major scratch and multiplies them by the sphere with its
+ * own GEMM */
+template<class ScalarType>
+void whiten_shuffled(int64_t NC, int64_t DataNF, ScalarType const * cdata, size_t const * perms, ScalarType * Sphere, tools::whitened_data<ScalarType> const & white_data){
+    int64_t NF = white_data.NF;
+    detail::sphere(NC, DataNF, NF, cdata, Sphere, [&](ScalarType const * data){
+        tools::scoped_blas_threads blas(1);
+        tools::parallel_for(0, white_data.frames(), whiten_chunk, [&](int64_t begin, int64_t end){
+            std::vector<ScalarType> gathered(NC*whiten_chunk), white(NC*whiten_chunk);
+            for(int64_t t = begin ; t < end ; t += whiten_chunk){
+                int64_t ns = std::min(whiten_chunk, end - t);
+                //Frames past NF are the zero padding of the last frame block
+                for(int64_t c = 0 ; c < NC ; ++c)
+                    for(int64_t f = 0 ; f < ns ; ++f)
+                        gathered[c*whiten_chunk + f] = (t + f < NF)?data[c*DataNF + perms[t + f]]:0;
+                backend<ScalarType>::gemm(NoTrans,NoTrans,ns,NC,NC,1,gathered.data(),whiten_chunk,Sphere,NC,0,white.data(),whiten_chunk);
+                for(int64_t c = 0 ; c < NC ; ++c)
+                    white_data.write(c, t, ns, white.data() + c*whiten_chunk);
+            }
+        });
+    });
 }
 
 }
@@ -26,6 +26,14 @@ struct operation_tag {
 struct value_gradient : public operation_tag {
     value_gradient(model_type_tag const & _model, size_t _sample_size, size_t _offset) : operation_tag(_model,_sample_size,_offset){ }
 };
+/** @brief Value and gradient that may be given up once the value is known to exceed bound : the function then
+ * returns false, with an estimate of the value and an undefined gradient, and sets *read (if given) to the
+ * number of samples it went through */
+struct bounded_value_gradient : public operation_tag {
+    bounded_value_gradient(model_type_tag const & _model, size_t _sample_size, size_t _offset, double _bound, size_t * _read = NULL) : operation_tag(_model,_sample_size,_offset), bound(_bound), read(_read){ }
+    double bound;
+    size_t * read;
+};
 struct hessian_vector_product : public operation_tag {
     hessian_vector_product(model_type_tag const & _model, size_t _sample_size, size_t _offset) : operation_tag(_model,_sample_size,_offset){ }
 };
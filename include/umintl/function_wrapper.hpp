@@ -16,6 +16,7 @@
 
 
 #include <iostream>
+#include <stdint.h>
 
 
 
@@ -35,8 +36,9 @@ namespace umintl{
             virtual unsigned int n_value_computations() const = 0;
             virtual unsigned int n_gradient_computations() const  = 0;
             virtual unsigned int n_hessian_vector_product_computations() const  = 0;
-            virtual unsigned int n_datapoints_accessed() const = 0;
+            virtual uint64_t n_datapoints_accessed() const = 0;
             virtual void compute_value_gradient(VectorType const & x, ScalarType & value, VectorType & gradient, value_gradient const & tag) = 0;
+            virtual bool compute_value_gradient(VectorType const & x, ScalarType & value, VectorType & gradient, value_gradient const & tag, ScalarType bound) = 0;
             virtual void compute_hv_product(VectorType const & x, VectorType const & g, VectorType const & v, VectorType & Hv, hessian_vector_product const & tag) = 0;
             virtual void compute_gradient_variance(VectorType const & x, VectorType & variance, gradient_variance const & tag) = 0;
             virtual void compute_hv_product_variance(VectorType const & x, VectorType const & v, VectorType & variance, hv_product_variance const & tag) = 0;
@@ -91,6 +93,15 @@ namespace umintl{
                 fun_(x,value,gradient,tag);
             }
 
+            //Compute both, possibly stopping once the value exceeds the bound. Falls back to the full evaluation
+            bool operator()(VectorType const & x, ScalarType& value, VectorType & gradient, bounded_value_gradient const & tag, int2type<false>){
+                (*this)(x,value,gradient,value_gradient(tag.model,tag.sample_size,tag.offset),int2type<is_call_possible<Fun,void(VectorType const &, ScalarType&, VectorType&, value_gradient)>::value>());
+                return true;
+            }
+            bool operator()(VectorType const & x, ScalarType& value, VectorType & gradient, bounded_value_gradient const & tag, int2type<true>){
+                return fun_(x,value,gradient,tag);
+            }
+
             //Compute hessian-vector product
             void operator()(VectorType const &, VectorType const &, VectorType&, hessian_vector_product const &, int2type<false>){
                 throw exceptions::incompatible_parameters(
@@ -113,7 +124,7 @@ namespace umintl{
               n_datapoints_accessed_ = 0;
             }
 
-            unsigned int n_datapoints_accessed() const{ return n_datapoints_accessed_; }
+            uint64_t n_datapoints_accessed() const{ return n_datapoints_accessed_; }
             unsigned int n_value_computations() const{ return n_value_computations_; }
             unsigned int n_gradient_computations() const { return n_gradient_computations_; }
             unsigned int n_hessian_vector_product_computations() const { return n_hessian_vector_product_computations_; }
@@ -125,6 +136,16 @@ namespace umintl{
               n_datapoints_accessed_+=tag.sample_size;
             }
 
+            bool compute_value_gradient(VectorType const & x,  ScalarType & value, VectorType & gradient, value_gradient const & tag, ScalarType bound){
+              size_t read = tag.sample_size;
+              bounded_value_gradient btag(tag.model, tag.sample_size, tag.offset, bound, &read);
+              bool complete = (*this)(x,value,gradient,btag,int2type<is_call_possible<Fun,bool(VectorType const &, ScalarType&, VectorType&, bounded_value_gradient)>::value>());
+              n_value_computations_++;
+              n_gradient_computations_++;
+              n_datapoints_accessed_+=read;
+              return complete;
+            }
+
             void compute_gradient_variance(VectorType const & x, VectorType & variance, gradient_variance const & tag){
               (*this)(x,variance,tag,int2type<is_call_possible<Fun,void(VectorType const &, VectorType &,gradient_variance)>::value>());
             }
@@ -199,7 +220,7 @@ namespace umintl{
             unsigned int n_gradient_computations_;
             unsigned int n_hessian_vector_product_computations_;
 
-            unsigned int n_datapoints_accessed_;
+            uint64_t n_datapoints_accessed_;
         };
 
     }
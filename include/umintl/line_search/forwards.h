@@ -37,6 +37,18 @@ namespace umintl{
   }
 
 
+  /** @brief Minimizer of the quadratic of value fa and slope dfa at a, and of value fb at b, within [xmin, xmax] */
+  template<class ScalarType>
+  inline ScalarType quadmin(ScalarType a,ScalarType b, ScalarType fa, ScalarType fb, ScalarType dfa, ScalarType xmin, ScalarType xmax){
+    ScalarType curvature = (fb - fa - dfa*(b - a))/((b - a)*(b - a));
+    if(!(curvature>0))
+      return (xmin+xmax)/2;
+    ScalarType x = a - dfa/(2*curvature);
+    if(std::isnan(x))
+      return (xmin+xmax)/2;
+    return std::min(std::max(x,xmin),xmax);
+  }
+
   template<class BackendType>
   struct line_search_result{
     private:
@@ -18,6 +18,7 @@
 #include "forwards.h"
 
 #include <cmath>
+#include <limits>
 
 #include <map>
 
@@ -31,8 +32,9 @@ struct strong_wolfe_powell : public line_search<BackendType>{
     //Tag
     /** @brief The constructor
      *  @param _max_evals maximum number of value-gradient evaluation in the line-search
+     *  @param _early_exit lets the function give up the evaluation of a trial step once it is known to be rejected
      */
-    strong_wolfe_powell(unsigned int _max_evals = 40) : line_search<BackendType>(_max_evals) { }
+    strong_wolfe_powell(unsigned int _max_evals = 40, bool _early_exit = false) : line_search<BackendType>(_max_evals), early_exit_(_early_exit) { }
 
     typedef typename BackendType::ScalarType ScalarType;
     typedef typename BackendType::VectorType VectorType;
@@ -57,6 +59,16 @@ private:
         return phi_alpha <= (phi0 + c1_*alpha );
     }
 
+    /** @brief phi(alpha) and its gradient at x, unless phi(alpha) exceeds bound, which rejects the step : with
+     *  early exit, the function may then stop with an estimate of phi(alpha) and return false */
+    bool evaluate(optimization_context<BackendType> & c, VectorType const & x, ScalarType & phi, VectorType & g, ScalarType bound) const {
+        if(!early_exit_){
+            c.fun().compute_value_gradient(x,phi,g,c.model().get_value_gradient_tag());
+            return true;
+        }
+        return c.fun().compute_value_gradient(x,phi,g,c.model().get_value_gradient_tag(),bound);
+    }
+
     /** @brief Curvature test for the strong wolfe-powell conditions */
     bool curvature(ScalarType dphi_alpha, ScalarType dphi0) const{
         return std::abs(dphi_alpha) <= c2_*std::abs(dphi0);
@@ -73,10 +85,14 @@ private:
         ScalarType alpha = 0;
         ScalarType dphi = 0;
         bool twice_close_to_boundary=false;
+        //The slope at alpha_high is unknown when its evaluation stopped early
+        bool exact_high = !std::isnan(dphi_alpha_high);
         for(unsigned int i = eval_offset ; i < max_evals ; ++i){
             ScalarType xmin = std::min(alpha_low,alpha_high);
             ScalarType xmax = std::max(alpha_low,alpha_high);
-            if(alpha_low < alpha_high)
+            if(!exact_high)
+                alpha = quadmin(alpha_low, alpha_high, phi_alpha_low, phi_alpha_high, dphi_alpha_low, xmin, xmax);
+            else if(alpha_low < alpha_high)
                 alpha = cubicmin(alpha_low, alpha_high, phi_alpha_low, phi_alpha_high, dphi_alpha_low, dphi_alpha_high,xmin,xmax);
             else
                 alpha = cubicmin(alpha_high, alpha_low, phi_alpha_high, phi_alpha_low, dphi_alpha_high, dphi_alpha_low,xmin,xmax);
@@ -104,13 +120,14 @@ private:
             //Compute phi(alpha) = f(x0 + alpha*p)
             BackendType::copy(c.N(),x0_,current_x);
             BackendType::axpy(c.N(),alpha,p,current_x);
-            c.fun().compute_value_gradient(current_x,current_phi,current_g,c.model().get_value_gradient_tag());
-            dphi = BackendType::dot(c.N(),current_g,p);
+            bool exact = evaluate(c,current_x,current_phi,current_g,std::min(c.val() + c1_*alpha, phi_alpha_low));
+            dphi = exact?BackendType::dot(c.N(),current_g,p):0;
 
-            if(!sufficient_decrease(alpha,current_phi, c.val()) || current_phi >= phi_alpha_low){
+            if(!exact || !sufficient_decrease(alpha,current_phi, c.val()) || current_phi >= phi_alpha_low){
                 alpha_high = alpha;
                 phi_alpha_high = current_phi;
                 dphi_alpha_high = dphi;
+                exact_high = exact;
 
             }
             else{
@@ -123,6 +140,7 @@ private:
                     alpha_high = alpha_low;
                     phi_alpha_high = phi_alpha_low;
                     dphi_alpha_high = dphi_alpha_low;
+                    exact_high = true;
                 }
                 alpha_low = alpha;
                 phi_alpha_low = current_phi;
@@ -173,11 +191,12 @@ public:
             //Compute phi(alpha) = f(x0 + alpha*p) ; dphi = grad(phi)_alpha'*p
             BackendType::copy(c.N(),x0_,current_x);
             BackendType::axpy(c.N(),alpha,p,current_x);
-            c.fun().compute_value_gradient(current_x,current_phi,current_g,c.model().get_value_gradient_tag());
-            dphi = BackendType::dot(c.N(),current_g,p);
+            bool exact = evaluate(c,current_x,current_phi,current_g,(i==1)?std::min(phi_0 + c1_*alpha, last_phi):phi_0 + c1_*alpha);
+            //A NaN slope tells zoom that the evaluation stopped early
+            dphi = exact?BackendType::dot(c.N(),current_g,p):std::numeric_limits<ScalarType>::quiet_NaN();
 
             //Tests sufficient decrease
-            if(!sufficient_decrease(alpha, current_phi, phi_0) || (i==1 && current_phi >= last_phi)){
+            if(!exact || !sufficient_decrease(alpha, current_phi, phi_0) || (i==1 && current_phi >= last_phi)){
                 return zoom(res, alpham1, last_phi, dphim1, alpha, current_phi, dphi, c, i);
             }
 
@@ -218,6 +237,8 @@ private:
     ScalarType c2_;
     /** temporary vector */
     VectorType x0_;
+    /** lets the trial steps stop early */
+    bool early_exit_;
 
 
 };
@@ -12,6 +12,7 @@
 #include "umintl/optimization_result.hpp"
 
 #include "umintl/model_base.hpp"
+#include "umintl/monitor.hpp"
 
 #include "umintl/function_wrapper.hpp"
 #include "umintl/optimization_context.hpp"
@@ -84,6 +85,7 @@ namespace umintl{
         tools::shared_ptr<umintl::line_search<BackendType> > line_search;
         tools::shared_ptr<umintl::stopping_criterion<BackendType> > stopping_criterion;
         tools::shared_ptr< model_base<BackendType> > model;
+        tools::shared_ptr< umintl::monitor<BackendType> > monitor;
         computation_type hessian_vector_product_computation;
 
         double tolerance;
@@ -158,6 +160,9 @@ namespace umintl{
             //Main loop
             c.fun().compute_value_gradient(c.x(), c.val(), c.g(), c.model().get_value_gradient_tag());
             for( ; c.iter() < iter ; ++c.iter()){
+                if(monitor.get())
+                    monitor->begin_iteration(c);
+
                 if(verbose >= 1 ){
                     IosFlagSaver flags_saver(std::cout);
                     std::cout << "Iteration " << std::setw(4) << c.iter()
@@ -166,7 +171,7 @@ namespace umintl{
                               << "; NG=" << std::setw(4) << c.fun().n_gradient_computations();
                     if(dynamic_cast<truncated_newton<BackendType>*>(direction.get()))
                         std::cout<< "; NH=" << std::setw(4) << c.fun().n_hessian_vector_product_computations() ;
-                    if(unsigned int ND = c.fun().n_datapoints_accessed())
+                    if(uint64_t ND = c.fun().n_datapoints_accessed())
                      std::cout << "; NPoints=" << std::scientific << std::setprecision(3) << (float)ND;
                     std::cout << std::endl;
                 }
@@ -184,8 +189,11 @@ namespace umintl{
 
                 (*line_search)(search_res, current_direction.get(), c);
 
-                if(search_res.has_failed)
+                if(search_res.has_failed){
+                    if(monitor.get())
+                        monitor->end_iteration(c);
                     return terminate(optimization_result::LINE_SEARCH_FAILED, res, N, c);
+                }
 
                 c.alpha() = search_res.best_alpha;
 
@@ -199,12 +207,17 @@ namespace umintl{
                 c.val() = search_res.best_phi;
 
                 if((*stopping_criterion)(c)){
+                    if(monitor.get())
+                        monitor->end_iteration(c);
                     return terminate(optimization_result::STOPPING_CRITERION, res, N, c);
                 }
                 current_direction = direction;
 
                 if(model->update(c))
                   c.fun().compute_value_gradient(c.x(), c.val(), c.g(), c.model().get_value_gradient_tag());
+
+                if(monitor.get())
+                    monitor->end_iteration(c);
             }
 
             return terminate(optimization_result::MAX_ITERATION_REACHED, res, N, c);
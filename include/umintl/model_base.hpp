@@ -4,6 +4,7 @@
 #include <cstddef>
 #include "umintl/forwards.h"
 #include "umintl/optimization_context.hpp"
+#include <algorithm>
 #include <cmath>
 
 namespace umintl{
@@ -110,6 +111,28 @@ struct dynamically_sampled : public model_base<BackendType> {
     hessian_vector_product get_hv_product_tag() const {
       return hessian_vector_product(STOCHASTIC,(size_t)(r_*S),H_offset_+offset_);
     }
+
+    /** @brief Sample size and offsets, to carry the sampling state over to another model */
+    size_t sample_size() const { return S; }
+    size_t offset() const { return offset_; }
+    size_t hv_offset() const { return H_offset_; }
+    size_t dataset_size() const { return N; }
+
+    /** @brief Hessian subsample ratio and variance test parameter, which may be changed between iterations */
+    double hessian_ratio() const { return r_; }
+    double theta() const { return theta_; }
+    void tune(double r, double theta){
+      r_ = r;
+      theta_ = theta;
+      H_offset_ = std::min(H_offset_, S - (size_t)(r_*S));
+    }
+
+    /** @brief Resumes the sampling from the state of another model over the same dataset */
+    void resume(size_t sample_size, size_t offset, size_t hv_offset){
+      S = std::min(sample_size,N);
+      offset_ = offset;
+      H_offset_ = hv_offset;
+    }
 private:
     double theta_;
     double r_;
@@ -0,0 +1,28 @@
+/* ===========================
+  Copyright (c) 2013 Philippe Tillet
+  UMinTL - Unconstrained Minimization Template Library
+
+  License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef UMINTL_MONITOR_HPP_
+#define UMINTL_MONITOR_HPP_
+
+#include "umintl/optimization_context.hpp"
+
+namespace umintl{
+
+/** @brief Base class for an iteration monitor
+ *
+ *  Notified at the beginning and at the end of each iteration of the minimizer. Does not alter the optimization procedure.
+ */
+template<class BackendType>
+struct monitor{
+    virtual ~monitor(){ }
+    virtual void begin_iteration(optimization_context<BackendType> &){ }
+    virtual void end_iteration(optimization_context<BackendType> &){ }
+};
+
+}
+
+#endif
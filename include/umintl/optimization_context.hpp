@@ -37,6 +37,9 @@ namespace umintl{
             gm1_ = BackendType::create_vector(dim_);
 
             BackendType::copy(dim_,x0,x_);
+            //The truncated Newton direction warm-starts from alpha*p
+            BackendType::set_to_value(p_,0,dim_);
+            alpha_ = 0;
         }
 
         model_base<BackendType> & model(){ return model_; }
@@ -0,0 +1,124 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_ADAPTIVE_SAMPLING_HPP_
+#define NEO_ICA_ADAPTIVE_SAMPLING_HPP_
+
+#include "lib/log_likelihood.hpp"
+
+#include "umintl/model_base.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+//Dynamic sampling tuned online, internal to the library
+
+namespace neo_ica{
+
+//Adaptive sampling : iterations per window, factor of a move, bounds of rho and theta, and share of the
+//evaluation time below which the Hessian-vector products are deemed cheap
+static const size_t adaptive_window = 5;
+static const double adaptive_factor = 1.25;
+static const double adaptive_rho[2] = {0.05, 1};
+static const double adaptive_theta[2] = {0.1, 0.9};
+static const double adaptive_cheap_hv = 0.1;
+
+//Dynamic sampling whose rho and theta are moved in turn every window of iterations, a move being kept if the
+//decrease per second, normalized by the squared gradient norm, improves
+template<class T>
+struct adaptive_sampling : public umintl::dynamically_sampled<typename umintl_backend<T>::type>{
+    typedef typename umintl_backend<T>::type BackendType;
+    typedef umintl::dynamically_sampled<BackendType> base_type;
+    typedef std::chrono::steady_clock clock;
+
+    adaptive_sampling(log_likelihood<T> const & objective, double rho, size_t fbatch, size_t NF, double theta, unsigned int verbose) :
+        base_type(rho, fbatch, NF, theta), objective_(objective), verbose_(verbose), count_(0), efficiency_(0), rate_(0), parameter_(0), moved_(false){
+        direction_[0] = direction_[1] = 1;
+        start();
+    }
+
+    bool update(umintl::optimization_context<BackendType> & c){
+        T gnorm2 = BackendType::dot(c.N(), c.gm1(), c.gm1());
+        if(gnorm2 > 0)
+            efficiency_ += std::max<double>(0, c.valm1() - c.val())/gnorm2;
+        if(++count_ == adaptive_window)
+            adjust();
+        return base_type::update(c);
+    }
+
+private:
+    void start(){
+        count_ = 0;
+        efficiency_ = 0;
+        last_ = clock::now();
+        gradient_seconds_ = objective_.gradient_seconds();
+        hv_seconds_ = objective_.hv_seconds();
+    }
+
+    //Moves parameter p by a factor in direction d, within its bounds. Returns false at a bound
+    bool move(int p, int d){
+        double rho = base_type::hessian_ratio(), theta = base_type::theta();
+        double & value = p?theta:rho;
+        double const * bounds = p?adaptive_theta:adaptive_rho;
+        double moved = std::min(bounds[1], std::max(bounds[0], value*std::pow(adaptive_factor, d)));
+        if(moved==value)
+            return false;
+        value = moved;
+        base_type::tune(rho, theta);
+        return true;
+    }
+
+    void adjust(){
+        double seconds = std::chrono::duration<double>(clock::now() - last_).count();
+        double hv = objective_.hv_seconds() - hv_seconds_;
+        double evaluations = hv + objective_.gradient_seconds() - gradient_seconds_;
+        double rate = (seconds > 0)?efficiency_/seconds:0;
+        if(moved_ && rate < rate_){
+            //Undone, the next window measures the rate again before moving
+            move(parameter_, -direction_[parameter_]);
+            direction_[parameter_] = -direction_[parameter_];
+            moved_ = false;
+        }
+        else{
+            rate_ = rate;
+            //theta is left alone once the gradients run over all the frames
+            bool sampled = base_type::sample_size() < base_type::dataset_size();
+            parameter_ = sampled?1 - parameter_:0;
+            if(parameter_==0 && evaluations > 0 && hv < adaptive_cheap_hv*evaluations)
+                direction_[0] = 1;
+            moved_ = move(parameter_, direction_[parameter_]);
+            if(!moved_){
+                direction_[parameter_] = -direction_[parameter_];
+                moved_ = move(parameter_, direction_[parameter_]);
+            }
+        }
+        if(verbose_ >= 1)
+            std::cout << "Adaptive sampling : rho=" << base_type::hessian_ratio() << ", theta=" << base_type::theta()
+                      << " (Hessian-vector products " << (int)(100*hv/std::max(evaluations, 1e-12)) << "% of the evaluations)" << std::endl;
+        start();
+    }
+
+    log_likelihood<T> const & objective_;
+    unsigned int verbose_;
+    size_t count_;
+    double efficiency_;
+    double rate_;
+    int parameter_;
+    int direction_[2];
+    bool moved_;
+    clock::time_point last_;
+    double gradient_seconds_;
+    double hv_seconds_;
+};
+
+}
+
+#endif
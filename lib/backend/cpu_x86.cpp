@@ -155,6 +155,7 @@ void cpu_x86::detect_host(){
 
         HW_AVX    = (info[2] & ((int)1 << 28)) != 0;
         HW_FMA3   = (info[2] & ((int)1 << 12)) != 0;
+        HW_F16C   = (info[2] & ((int)1 << 29)) != 0;
 
         HW_RDRAND = (info[2] & ((int)1 << 30)) != 0;
     }
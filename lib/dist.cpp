@@ -8,16 +8,24 @@
  * ===========================*/
 
 #include <cmath>
+#include <algorithm>
 #include <cstddef>
-#include <omp.h>
 #include <immintrin.h>
 #include <iostream>
+#include <type_traits>
+#include <vector>
 
 #include "neo_ica/backend/cpu_x86.h"
 #include "neo_ica/math/math.h"
 #include "neo_ica/dist.h"
-#include "neo_ica/tools/round.hpp"
 #include "neo_ica/tools/simd.hpp"
+#include "neo_ica/tools/arena.h"
+#include "neo_ica/tools/elementwise.hpp"
+#include "neo_ica/tools/layout.hpp"
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/tile_scheduler.h"
+#include "neo_ica/tools/profiler.h"
+#include "neo_ica/tools/tracer.h"
 
 namespace neo_ica{
 
@@ -78,17 +86,20 @@ T infomax<T>::dphi(T z, T)
 }
 
 template<class T>
+template<class M>
 __m128 infomax<T>::logp(__m128 const & z, __m128 const &)
-{   return  _mm_add_ps(log_1pe(_mm_mul_ps(_m2, z)), _mm_add_ps(_mlog2, z)); }
+{   return  _mm_add_ps(M::log_1pe(_mm_mul_ps(_m2, z)), _mm_add_ps(_mlog2, z)); }
 
 template<class T>
+template<class M>
 __m128 infomax<T>::phi(__m128 const &  z, __m128 const &)
-{  return tanh(z); }
+{  return M::tanh(z); }
 
 template<class T>
+template<class M>
 __m128 infomax<T>::dphi(__m128 const &  z, __m128 const &)
 {
-    __m128 y = tanh(z);
+    __m128 y = M::tanh(z);
     return 1 - y*y;
 }
 
@@ -114,30 +125,68 @@ T extended_infomax<T>::dphi(T z, T k)
 }
 
 template<class T>
+template<class M>
 __m128 extended_infomax<T>::logp(__m128 const & z, __m128 const &  k)
 {
     //t1 = .5z^2
     __m128 t1 = _mm_mul_ps(_0_5, _mm_mul_ps(z, z));
     //t2 = (log(1 + exp(-2*z)) - ln(2) + z)
-    __m128 t2 = _mm_add_ps(log_1pe(_mm_mul_ps(_m2, z)), _mm_add_ps(_mlog2, z));
+    __m128 t2 = _mm_add_ps(M::log_1pe(_mm_mul_ps(_m2, z)), _mm_add_ps(_mlog2, z));
     //res = t1 + k*t2
     return _mm_add_ps(t1, _mm_mul_ps(k, t2));
 }
 
 template<class T>
+template<class M>
 __m128 extended_infomax<T>::phi(__m128 const &  z, __m128 const &  k)
-{  return _mm_add_ps(z, _mm_mul_ps(k, tanh(z))); }
+{  return _mm_add_ps(z, _mm_mul_ps(k, M::tanh(z))); }
 
 template<class T>
+template<class M>
 __m128 extended_infomax<T>::dphi(__m128 const &  z, __m128 const &  k)
 {
-    __m128 y = tanh(z);
+    __m128 y = M::tanh(z);
     //res = (1 + k) - k*y*y;
     return _mm_sub_ps(_mm_add_ps(_1, k),
                       _mm_mul_ps(k, _mm_mul_ps(y, y)));
 }
 
 
+/*
+ * ---------------------------
+ * Scheduling
+ * ---------------------------
+ */
+
+//Frames per scheduling unit : one arena-aligned cache line
+template<class T>
+static int64_t frame_granularity()
+{ return arena_alignment/sizeof(T); }
+
+//Runs tile(t, c, begin, end) over the (channel, frame block) tiles of the work-stealing tile_scheduler
+template<class Tile>
+static void for_each_tile(tile_scheduler & tiles, const char* name, Tile const & tile){
+    parallel_run([&](int tid, int){
+        scoped_span span(name);
+        int64_t t, c, begin, end;
+        while(tiles.next(tid, t)){
+            tiles.tile(t, c, begin, end);
+            tile(t, c, begin, end);
+        }
+    });
+}
+
+//Per-tile partial sums, reduced in block order so that the result does not depend on the schedule
+template<class T>
+static void reduce_mu(tile_scheduler const & tiles, std::vector<double> const & partial, int64_t NC, int64_t NS, T* res){
+    for(int64_t c = 0 ; c < NC ; ++c){
+        double sum = 0;
+        for(int64_t b = 0 ; b < tiles.n_blocks() ; ++b)
+            sum += partial[b*NC + c];
+        res[c] = -sum/NS;
+    }
+}
+
 /*
  * ---------------------------
  * Fallback
@@ -145,31 +194,33 @@ __m128 extended_infomax<T>::dphi(__m128 const &  z, __m128 const &  k)
  */
 template<class T, template<class> class F>
 void dist<T, F>::phi_fb(int64_t off, int64_t NS, T* pz, T* pk, T* res) const{
-    for(int64_t c = 0 ; c < NC_ ; ++c){
-        T k = pk[c];
-        for(int64_t f = off ; f < off + NS ; ++f)
-          res[c*NF_+f] = F<T>::phi(pz[c*NF_+f], k);
-    }
+    tile_scheduler tiles(NC_, off, NS, frame_granularity<T>(), thread_pool::get().size());
+    for_each_tile(tiles, "dist_phi_worker", [&](int64_t, int64_t c, int64_t begin, int64_t end){
+        for(int64_t f = begin ; f < end ; ++f)
+          res[c*NF_+f] = F<T>::phi(pz[c*NF_+f], pk[c]);
+    });
 }
 
 template<class T, template<class> class F>
 void dist<T, F>::dphi_fb(int64_t off, int64_t NS, T * pz, T* pk, T* res) const {
-    for(int64_t c = 0 ; c < NC_ ; ++c){
-        T k = pk[c];
-        for(int64_t f = off ; f < off + NS ; ++f)
-            res[c*NF_ + f] = F<T>::dphi(pz[c*NF_ + f], k);
-    }
+    tile_scheduler tiles(NC_, off, NS, frame_granularity<T>(), thread_pool::get().size());
+    for_each_tile(tiles, "dist_dphi_worker", [&](int64_t, int64_t c, int64_t begin, int64_t end){
+        for(int64_t f = begin ; f < end ; ++f)
+            res[c*NF_ + f] = F<T>::dphi(pz[c*NF_ + f], pk[c]);
+    });
 }
 
 template<class T, template<class> class F>
 void dist<T, F>::mu_fb(int64_t off, int64_t NS, T * pz, T* pk, T* res) const {
-    for(int64_t c = 0 ; c < NC_ ; ++c){
+    tile_scheduler tiles(NC_, off, NS, frame_granularity<T>(), thread_pool::get().size());
+    std::vector<double> partial(tiles.n_tiles());
+    for_each_tile(tiles, "dist_mu_worker", [&](int64_t t, int64_t c, int64_t begin, int64_t end){
         double sum = 0;
-        T k = pk[c];
-        for(int64_t f = off ; f < off + NS ; ++f)
-          sum += F<T>::logp(pz[c*NF_ + f], k);
-        res[c] = -sum/NS;
-    }
+        for(int64_t f = begin ; f < end ; ++f)
+          sum += F<T>::logp(pz[c*NF_ + f], pk[c]);
+        partial[t] = sum;
+    });
+    reduce_mu(tiles, partial, NC_, NS, res);
 }
 
 /*
@@ -177,67 +228,400 @@ void dist<T, F>::mu_fb(int64_t off, int64_t NS, T * pz, T* pk, T* res) const {
  * SSE3
  * ---------------------------
  */
+
+//Frames [begin, end) of the row pz of one channel, with the transcendentals of the accuracy tier M. The exact
+//tier goes element by element in the precision T
+template<class T, template<class> class F, class M>
+static void phi_tile(T* pz, T k, int64_t begin, int64_t end, T* res){
+    if(M::per_element){
+        for(int64_t f = begin ; f < end ; ++f)
+            res[f] = F<T>::phi(pz[f], k);
+        return;
+    }
+    __m128 vk = _mm_set1_ps((T)k);
+    int64_t f = begin;
+    //Scalar peel up to a 16-byte boundary, aligned loads/stores if res shares the alignment of pz
+    for(; f < end && !is_aligned(&pz[f], 16) ; ++f)
+      res[f] = F<T>::phi(pz[f], k);
+    if(is_aligned(&res[f], 16))
+        for(; f + 3 < end ; f+=4)
+            cast_f32_store_aligned<T>(&res[f],F<T>::template phi<M>(load_cast_f32_aligned<T>(&pz[f]), vk));
+    else
+        for(; f + 3 < end ; f+=4)
+            cast_f32_store<T>(&res[f],F<T>::template phi<M>(load_cast_f32<T>(&pz[f]), vk));
+    for(; f < end ; ++f)
+      res[f] = F<T>::phi(pz[f], k);
+}
+
+template<class T, template<class> class F, class M>
+static void dphi_tile(T* pz, T k, int64_t begin, int64_t end, T* res){
+    if(M::per_element){
+        for(int64_t f = begin ; f < end ; ++f)
+            res[f] = F<T>::dphi(pz[f], k);
+        return;
+    }
+    __m128 vk = _mm_set1_ps(k);
+    int64_t f = begin;
+    for(; f < end && !is_aligned(&pz[f], 16) ; ++f)
+      res[f] = F<T>::dphi(pz[f], k);
+    if(is_aligned(&res[f], 16))
+        for(; f + 3 < end ; f+=4)
+            cast_f32_store_aligned<T>(&res[f],F<T>::template dphi<M>(load_cast_f32_aligned<T>(&pz[f]), vk));
+    else
+        for(; f + 3 < end ; f+=4)
+            cast_f32_store<T>(&res[f],F<T>::template dphi<M>(load_cast_f32<T>(&pz[f]), vk));
+    for(; f < end ; ++f)
+      res[f] = F<T>::dphi(pz[f], k);
+}
+
+template<class T, template<class> class F, class M>
+static double logp_tile(T* pz, T k, int64_t begin, int64_t end){
+    if(M::per_element){
+        double sum = 0;
+        for(int64_t f = begin ; f < end ; ++f)
+            sum += F<T>::logp(pz[f], k);
+        return sum;
+    }
+    __m128d vsum = _mm_set1_pd((double)0);
+    __m128 vk = _mm_set1_ps(k);
+    double sum = 0;
+    int64_t f = begin;
+    for(; f < end && !is_aligned(&pz[f], 16) ; ++f)
+      sum += F<T>::logp(pz[f], k);
+    for(; f + 3 < end ; f+=4){
+        __m128 logp = F<T>::template logp<M>(load_cast_f32_aligned<T>(&pz[f]), vk);
+        //sum += logp[0] + logp[1] + logp[2] + logp[3]
+        vsum=_mm_add_pd(vsum,_mm_cvtps_pd(logp));
+        vsum=_mm_add_pd(vsum,_mm_cvtps_pd(_mm_movehl_ps(logp,logp)));
+    }
+    vsum = _mm_hadd_pd(vsum, vsum);
+    double vector_sum;
+    _mm_store_sd(&vector_sum, vsum);
+    sum += vector_sum;
+    for(; f < end; ++f)
+      sum += F<T>::logp(pz[f], k);
+    return sum;
+}
+
+//Tile kernels of the accuracy tier of the run, selected once per tile
 template<class T, template<class> class F>
-void dist<T, F>::phi_sse3(int64_t off, int64_t NS, T* pz, T* pk, T* res) const {
-    #pragma omp parallel for
-    for(int64_t c = 0 ; c < NC_ ; ++c){
-        T k = pk[c];
-        __m128 vk = _mm_set1_ps((T)k);
-        int64_t f = off;
-        for(; f < round_to_previous_multiple(off+NS-3,4)  ; f+=4){
-            __m128 z = load_cast_f32<T>(&pz[c*NF_+f]);
-            cast_f32_store<T>(&res[c*NF_+f],F<T>::phi(z, vk));
-        }
-        for(; f < off+NS ; ++f)
-          res[c*NF_+f] = F<T>::phi(pz[c*NF_+f], k);
+static void phi_tile(accuracy_tier tier, T* pz, T k, int64_t begin, int64_t end, T* res){
+    switch(tier){
+        case ACCURACY_EXACT: phi_tile<T, F, exact_tier>(pz, k, begin, end, res); break;
+        case ACCURACY_FAST: phi_tile<T, F, fast_tier>(pz, k, begin, end, res); break;
+        default: phi_tile<T, F, fmath_tier>(pz, k, begin, end, res); break;
     }
 }
 
 template<class T, template<class> class F>
-void dist<T, F>::dphi_sse3(int64_t off, int64_t NS, T* pz, T* pk, T* res) const {
-    #pragma omp parallel for
-    for(int64_t c = 0 ; c < NC_ ; ++c){
-        T k = pk[c];
-        __m128 vk = _mm_set1_ps(k);
-        int64_t f = off;
-        for(; f < round_to_previous_multiple(off+NS-3,4)  ; f+=4){
-            __m128 z = load_cast_f32<T>(&pz[c*NF_+f]);
-            cast_f32_store<T>(&res[c*NF_+f],F<T>::dphi(z, vk));
-        }
-        for(; f < off+NS ; ++f)
-          res[c*NF_+f] = F<T>::dphi(pz[c*NF_ + f], k);
+static void dphi_tile(accuracy_tier tier, T* pz, T k, int64_t begin, int64_t end, T* res){
+    switch(tier){
+        case ACCURACY_EXACT: dphi_tile<T, F, exact_tier>(pz, k, begin, end, res); break;
+        case ACCURACY_FAST: dphi_tile<T, F, fast_tier>(pz, k, begin, end, res); break;
+        default: dphi_tile<T, F, fmath_tier>(pz, k, begin, end, res); break;
     }
 }
 
+template<class T, template<class> class F>
+static double logp_tile(accuracy_tier tier, T* pz, T k, int64_t begin, int64_t end){
+    switch(tier){
+        case ACCURACY_EXACT: return logp_tile<T, F, exact_tier>(pz, k, begin, end);
+        case ACCURACY_FAST: return logp_tile<T, F, fast_tier>(pz, k, begin, end);
+        default: return logp_tile<T, F, fmath_tier>(pz, k, begin, end);
+    }
+}
+
+template<class T, template<class> class F>
+void dist<T, F>::phi_sse3(int64_t off, int64_t NS, T* pz, T* pk, T* res) const {
+    tile_scheduler tiles(NC_, off, NS, frame_granularity<T>(), thread_pool::get().size());
+    for_each_tile(tiles, "dist_phi_worker", [&](int64_t, int64_t c, int64_t begin, int64_t end){
+        phi_tile<T, F>(accuracy_, pz + c*NF_, pk[c], begin, end, res + c*NF_);
+    });
+}
+
+template<class T, template<class> class F>
+void dist<T, F>::dphi_sse3(int64_t off, int64_t NS, T* pz, T* pk, T* res) const {
+    tile_scheduler tiles(NC_, off, NS, frame_granularity<T>(), thread_pool::get().size());
+    for_each_tile(tiles, "dist_dphi_worker", [&](int64_t, int64_t c, int64_t begin, int64_t end){
+        dphi_tile<T, F>(accuracy_, pz + c*NF_, pk[c], begin, end, res + c*NF_);
+    });
+}
 
 template<class T, template<class> class F>
 void dist<T, F>::mu_sse3(int64_t off, int64_t NS, T* pz, T* pk, T* res) const {
-    #pragma omp parallel for
-    for(int64_t c = 0 ; c < NC_ ; ++c){
-        __m128d vsum = _mm_set1_pd((double)0);
-        T k = pk[c];
-        __m128 vk = _mm_set1_ps(k);
-        double sum = 0;
-        int64_t f = off;
-        for(; f < round_to_previous_multiple(off+NS-3,4)  ; f+=4){
-            __m128 z = load_cast_f32<T>(&pz[c*NF_+f]);
-            __m128 logp = F<T>::logp(z, vk);
-            //sum += logp[0] + logp[1] + logp[2] + logp[3]
-            vsum=_mm_add_pd(vsum,_mm_cvtps_pd(logp));
-            vsum=_mm_add_pd(vsum,_mm_cvtps_pd(_mm_movehl_ps(logp,logp)));
+    tile_scheduler tiles(NC_, off, NS, frame_granularity<T>(), thread_pool::get().size());
+    std::vector<double> partial(tiles.n_tiles());
+    for_each_tile(tiles, "dist_mu_worker", [&](int64_t t, int64_t c, int64_t begin, int64_t end){
+        partial[t] = logp_tile<T, F>(accuracy_, pz + c*NF_, pk[c], begin, end);
+    });
+    reduce_mu(tiles, partial, NC_, NS, res);
+}
+
+
+/*
+ * ---------------------------
+ * Fused small-NC kernels
+ * ---------------------------
+ */
+
+//Largest number of channels with a fused kernel. Frames are processed by blocks that keep Z, RZ and the
+//data of the block in L1/L2, and the single precision sums are flushed to double precision every few blocks
+static const int64_t fused_max_channels = 32;
+static const int64_t fused_block = 256;
+static const int64_t fused_flush = 4096;
+
+static inline __m128 sse_fmadd(__m128 a, __m128 b, __m128 c)
+{ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+//Frame f of the channel 0 of X
+template<bool BLOCKED>
+static inline float const * fused_frame(float const * X, int64_t NC, int64_t f)
+{ return BLOCKED?(X + (f/frame_block)*NC*frame_block + f%frame_block):(X + f); }
+
+/*
+ * Register-blocked micro-kernels, stamped out once per instruction set. NCT is the number of channels when known
+ * at compile time (0 otherwise), so that the channel loops of the common sizes are fully unrolled. Frames are
+ * swept 2*width at a time : B must be a multiple of it. X is either channel-major (rows at a stride of ldx) or, if
+ * BLOCKED, frame-blocked (ldx is then frame_block, and 2*width divides it).
+ * project : Y(j,:) = sum_c W(c,j)*X(c,:), i.e. Z = X*W, by 4 output channels and 2 vectors of frames.
+ * accumulate : S(i,j) += X(i,:).*Y(j,:) lane-wise, i.e. X'*Y in width partial sums per pair, by 4x2 pairs.
+ * The comments of the body must stay C-style.
+ */
+#define DEFINE_FUSED_MICROKERNELS(NAME, TARGET, VEC, WIDTH, LOAD, STORE, SET1, ZERO, FMADD) \
+struct NAME{ \
+    static const int64_t width = WIDTH; \
+\
+    template<int NCT, bool BLOCKED> TARGET \
+    static void project(int64_t runtime_NC, float const * X, int64_t ldx, int64_t B, float const * W, float * Y, int64_t ldy){ \
+        const int64_t NC = (NCT > 0)?NCT:runtime_NC; \
+        for(int64_t f = 0 ; f < B ; f += 2*WIDTH){ \
+            float const * Xf = fused_frame<BLOCKED>(X, NC, f); \
+            int64_t j = 0; \
+            for(; j + 4 <= NC ; j += 4){ \
+                VEC a0 = ZERO(), a1 = ZERO(), a2 = ZERO(), a3 = ZERO(); \
+                VEC b0 = ZERO(), b1 = ZERO(), b2 = ZERO(), b3 = ZERO(); \
+                for(int64_t c = 0 ; c < NC ; ++c){ \
+                    VEC x0 = LOAD(Xf + c*ldx), x1 = LOAD(Xf + c*ldx + WIDTH); \
+                    VEC w0 = SET1(W[j*NC + c]), w1 = SET1(W[(j+1)*NC + c]); \
+                    VEC w2 = SET1(W[(j+2)*NC + c]), w3 = SET1(W[(j+3)*NC + c]); \
+                    a0 = FMADD(w0, x0, a0); b0 = FMADD(w0, x1, b0); \
+                    a1 = FMADD(w1, x0, a1); b1 = FMADD(w1, x1, b1); \
+                    a2 = FMADD(w2, x0, a2); b2 = FMADD(w2, x1, b2); \
+                    a3 = FMADD(w3, x0, a3); b3 = FMADD(w3, x1, b3); \
+                } \
+                STORE(Y + j*ldy + f, a0); STORE(Y + j*ldy + f + WIDTH, b0); \
+                STORE(Y + (j+1)*ldy + f, a1); STORE(Y + (j+1)*ldy + f + WIDTH, b1); \
+                STORE(Y + (j+2)*ldy + f, a2); STORE(Y + (j+2)*ldy + f + WIDTH, b2); \
+                STORE(Y + (j+3)*ldy + f, a3); STORE(Y + (j+3)*ldy + f + WIDTH, b3); \
+            } \
+            for(; j < NC ; ++j){ \
+                VEC a = ZERO(), b = ZERO(); \
+                for(int64_t c = 0 ; c < NC ; ++c){ \
+                    VEC w = SET1(W[j*NC + c]); \
+                    a = FMADD(w, LOAD(Xf + c*ldx), a); \
+                    b = FMADD(w, LOAD(Xf + c*ldx + WIDTH), b); \
+                } \
+                STORE(Y + j*ldy + f, a); STORE(Y + j*ldy + f + WIDTH, b); \
+            } \
+        } \
+    } \
+\
+    template<int NCT, bool BLOCKED> TARGET \
+    static void accumulate(int64_t runtime_NC, float const * X, int64_t ldx, int64_t B, float const * Y, int64_t ldy, float * S){ \
+        const int64_t NC = (NCT > 0)?NCT:runtime_NC; \
+        const int64_t NC4 = NC - NC%4; \
+        const int64_t NC2 = NC - NC%2; \
+        for(int64_t j = 0 ; j < NC2 ; j += 2) \
+            for(int64_t i = 0 ; i < NC4 ; i += 4){ \
+                float * s0 = S + (j*NC + i)*WIDTH; \
+                float * s1 = S + ((j+1)*NC + i)*WIDTH; \
+                VEC s00 = LOAD(s0), s01 = LOAD(s0 + WIDTH), s02 = LOAD(s0 + 2*WIDTH), s03 = LOAD(s0 + 3*WIDTH); \
+                VEC s10 = LOAD(s1), s11 = LOAD(s1 + WIDTH), s12 = LOAD(s1 + 2*WIDTH), s13 = LOAD(s1 + 3*WIDTH); \
+                for(int64_t f = 0 ; f < B ; f += WIDTH){ \
+                    float const * Xf = fused_frame<BLOCKED>(X, NC, f); \
+                    VEC x0 = LOAD(Xf + i*ldx), x1 = LOAD(Xf + (i+1)*ldx); \
+                    VEC x2 = LOAD(Xf + (i+2)*ldx), x3 = LOAD(Xf + (i+3)*ldx); \
+                    VEC y0 = LOAD(Y + j*ldy + f), y1 = LOAD(Y + (j+1)*ldy + f); \
+                    s00 = FMADD(x0, y0, s00); s01 = FMADD(x1, y0, s01); s02 = FMADD(x2, y0, s02); s03 = FMADD(x3, y0, s03); \
+                    s10 = FMADD(x0, y1, s10); s11 = FMADD(x1, y1, s11); s12 = FMADD(x2, y1, s12); s13 = FMADD(x3, y1, s13); \
+                } \
+                STORE(s0, s00); STORE(s0 + WIDTH, s01); STORE(s0 + 2*WIDTH, s02); STORE(s0 + 3*WIDTH, s03); \
+                STORE(s1, s10); STORE(s1 + WIDTH, s11); STORE(s1 + 2*WIDTH, s12); STORE(s1 + 3*WIDTH, s13); \
+            } \
+        /* Pairs left out of the 4x2 blocks */ \
+        for(int64_t j = 0 ; j < NC ; ++j) \
+            for(int64_t i = (j < NC2)?NC4:0 ; i < NC ; ++i){ \
+                float * s = S + (j*NC + i)*WIDTH; \
+                VEC acc = LOAD(s); \
+                for(int64_t f = 0 ; f < B ; f += WIDTH) \
+                    acc = FMADD(LOAD(fused_frame<BLOCKED>(X, NC, f) + i*ldx), LOAD(Y + j*ldy + f), acc); \
+                STORE(s, acc); \
+            } \
+    } \
+}
+
+#define NEO_ICA_NO_TARGET
+DEFINE_FUSED_MICROKERNELS(fused_sse, NEO_ICA_NO_TARGET, __m128, 4, _mm_loadu_ps, _mm_storeu_ps, _mm_set1_ps, _mm_setzero_ps, sse_fmadd);
+#if defined(__GNUC__)
+DEFINE_FUSED_MICROKERNELS(fused_avx2, __attribute__((target("avx2,fma"))), __m256, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, _mm256_setzero_ps, _mm256_fmadd_ps);
+#endif
+#undef NEO_ICA_NO_TARGET
+
+/* Sweep of the frames [begin, end) of one worker, block by block : Z (and RZ) by the micro-kernels, the
+ * nonlinearity in place with the tile kernels of the SSE3 path, then the update of the sums.
+ * Blocks start on the frame blocks of the blocked layout. A block that does not (the first one), that is
+ * not a multiple of 2*width frames (the last one) or that is stored in 16 bits is copied, in single precision,
+ * into a zero-padded buffer of the same layout : the padding contributes nothing to the sums (its data is zero)
+ * and is left out of logp. logp and acc are accumulated into */
+template<template<class> class F, bool HV, int NCT, class K, bool BLOCKED>
+static void fused_sweep(whitened_data<float> const & X, accuracy_tier tier, int64_t begin, int64_t end,
+                        float const * W, float const * V, float const * signs, double * logp, double * acc){
+    const int64_t NC = (NCT > 0)?NCT:X.NC;
+    const int64_t ldx = BLOCKED?frame_block:X.NF;
+    std::vector<float> Y(NC*fused_block), RZ(HV?NC*fused_block:0), padded, S(NC*NC*K::width, 0);
+    int64_t pending = 0;
+    for(int64_t block = begin ; block < end ; ){
+        bool aligned = !BLOCKED || block%frame_block==0;
+        int64_t ns = std::min(aligned?block + fused_block:round_to_next_multiple<int64_t>(block, frame_block), end) - block;
+        int64_t nb = (ns + 2*K::width - 1)/(2*K::width)*(2*K::width);
+        float const * Xb;
+        int64_t ldxb = ldx;
+        if(nb > ns || !aligned || X.storage!=STORAGE_NATIVE){
+            if(BLOCKED){
+                padded.assign(NC*blocked_frames(nb), 0);
+                for(int64_t c = 0 ; c < NC ; ++c)
+                    for(int64_t f = 0, count ; f < ns ; f += count){
+                        count = std::min(ns - f, frame_block - (block + f)%frame_block);
+                        X.read(c, block + f, count, padded.data() + blocked_offset(NC, c, f));
+                    }
+            }
+            else{
+                padded.assign(NC*nb, 0);
+                for(int64_t c = 0 ; c < NC ; ++c)
+                    X.read(c, block, ns, padded.data() + c*nb);
+                ldxb = nb;
+            }
+            Xb = padded.data();
         }
-        vsum = _mm_hadd_pd(vsum, vsum);
-        _mm_store_sd(&sum, vsum);
-        for(; f < off+NS; ++f)
-          sum += F<T>::logp(pz[c*NF_ + f], k);
-        res[c] = -sum/NS;
+        else
+            Xb = fused_frame<BLOCKED>(X.native(), NC, block);
+
+        K::template project<NCT, BLOCKED>(NC, Xb, ldxb, nb, W, Y.data(), fused_block);
+        if(HV){
+            K::template project<NCT, BLOCKED>(NC, Xb, ldxb, nb, V, RZ.data(), fused_block);
+            for(int64_t j = 0 ; j < NC ; ++j){
+                float * y = Y.data() + j*fused_block;
+                dphi_tile<float, F>(tier, y, signs[j], 0, nb, y);
+            }
+            multiply<float>(NC, nb, Y.data(), fused_block, RZ.data(), fused_block, Y.data(), fused_block);
+        }
+        else
+            for(int64_t j = 0 ; j < NC ; ++j){
+                float * y = Y.data() + j*fused_block;
+                logp[j] += logp_tile<float, F>(tier, y, signs[j], 0, ns);
+                phi_tile<float, F>(tier, y, signs[j], 0, nb, y);
+            }
+        K::template accumulate<NCT, BLOCKED>(NC, Xb, ldxb, nb, Y.data(), fused_block, S.data());
+
+        block += ns;
+        pending += nb;
+        if(pending >= fused_flush || block >= end){
+            for(int64_t i = 0 ; i < NC*NC ; ++i){
+                double sum = 0;
+                for(int64_t l = 0 ; l < K::width ; ++l)
+                    sum += S[i*K::width + l];
+                acc[i] += sum;
+            }
+            std::fill(S.begin(), S.end(), 0);
+            pending = 0;
+        }
+    }
+}
+
+template<template<class> class F, bool HV, class K, bool BLOCKED>
+static void fused_dispatch(whitened_data<float> const & X, accuracy_tier tier, int64_t begin, int64_t end,
+                           float const * W, float const * V, float const * signs, double * logp, double * acc){
+    switch(X.NC){
+        case 4: fused_sweep<F, HV, 4, K, BLOCKED>(X, tier, begin, end, W, V, signs, logp, acc); break;
+        case 8: fused_sweep<F, HV, 8, K, BLOCKED>(X, tier, begin, end, W, V, signs, logp, acc); break;
+        case 16: fused_sweep<F, HV, 16, K, BLOCKED>(X, tier, begin, end, W, V, signs, logp, acc); break;
+        case 32: fused_sweep<F, HV, 32, K, BLOCKED>(X, tier, begin, end, W, V, signs, logp, acc); break;
+        default: fused_sweep<F, HV, 0, K, BLOCKED>(X, tier, begin, end, W, V, signs, logp, acc); break;
     }
 }
 
+template<template<class> class F, bool HV, class K>
+static void fused_dispatch(whitened_data<float> const & X, accuracy_tier tier, int64_t begin, int64_t end,
+                           float const * W, float const * V, float const * signs, double * logp, double * acc){
+    if(X.blocked)
+        fused_dispatch<F, HV, K, true>(X, tier, begin, end, W, V, signs, logp, acc);
+    else
+        fused_dispatch<F, HV, K, false>(X, tier, begin, end, W, V, signs, logp, acc);
+}
+
+//Double precision data keeps the GEMM path : the fused kernels evaluate Z in single precision
+template<template<class> class F, bool HV, class T>
+static bool fused_evaluate(whitened_data<T> const &, accuracy_tier, int64_t, int64_t, T const *, T const *, T const *, T *, T *)
+{ return false; }
+
+/* Each worker sweeps its thread_frame_range into private double precision sums, reduced in thread order.
+ * The caller checks that NC is at most fused_max_channels */
+template<template<class> class F, bool HV>
+static bool fused_evaluate(whitened_data<float> const & X, accuracy_tier tier, int64_t off, int64_t NS,
+                           float const * W, float const * V, float const * signs, float * mu, float * acc){
+#if defined(__GNUC__)
+    bool avx2 = cpu.OS_AVX && cpu.HW_AVX2 && cpu.HW_FMA3;
+#else
+    bool avx2 = false;
+#endif
+    int64_t NC = X.NC;
+    int nthreads = thread_pool::get().size();
+    int64_t stride = NC + NC*NC;
+    std::vector<double> partial(nthreads*stride, 0);
+    parallel_run([&](int tid, int nworkers){
+        scoped_span span(HV?"fused_hv_worker":"fused_value_gradient_worker");
+        int64_t begin, end;
+        thread_frame_range(off, NS, frame_granularity<float>(), tid, nworkers, begin, end);
+        if(begin >= end)
+            return;
+        double * logp = &partial[tid*stride];
+        double * sums = &partial[tid*stride + NC];
+#if defined(__GNUC__)
+        if(avx2)
+            fused_dispatch<F, HV, fused_avx2>(X, tier, begin, end, W, V, signs, logp, sums);
+        else
+#endif
+            fused_dispatch<F, HV, fused_sse>(X, tier, begin, end, W, V, signs, logp, sums);
+    });
+    for(int64_t i = 0 ; i < stride ; ++i){
+        double sum = 0;
+        for(int tid = 0 ; tid < nthreads ; ++tid)
+            sum += partial[tid*stride + i];
+        if(i >= NC)
+            acc[i - NC] = (float)sum;
+        else if(!HV)
+            mu[i] = (float)(-sum/NS);
+    }
+    return true;
+}
+
+
+/*
+ * ---------------------------
+ * Dispatch
+ * ---------------------------
+ */
+
+//Nominal per-element cost of the nonlinearities (one fmath exp/log and the surrounding arithmetic)
+static const uint64_t logp_flops = 40;
+static const uint64_t phi_flops = 20;
+static const uint64_t dphi_flops = 22;
 
 template<class T, template<class> class F>
 void dist<T, F>::mu(int64_t off, int64_t NS, T * z1, T* signs, T * mu) const
 {
+    uint64_t N = (uint64_t)NC_*NS;
+    scoped_phase phase(PHASE_DIST_MU, N*sizeof(T), N*logp_flops);
     if(cpu.HW_SSE3)
         mu_sse3(off, NS, z1, signs, mu);
     else
@@ -247,6 +631,8 @@ void dist<T, F>::mu(int64_t off, int64_t NS, T * z1, T* signs, T * mu) const
 template<class T, template<class> class F>
 void dist<T, F>::phi(int64_t off, int64_t NS, T * z1, T* signs, T* phi) const
 {
+    uint64_t N = (uint64_t)NC_*NS;
+    scoped_phase phase(PHASE_DIST_PHI, 2*N*sizeof(T), N*phi_flops);
     if(cpu.HW_SSE3)
         phi_sse3(off, NS, z1, signs, phi);
     else
@@ -256,15 +642,44 @@ void dist<T, F>::phi(int64_t off, int64_t NS, T * z1, T* signs, T* phi) const
 template<class T, template<class> class F>
 void dist<T, F>::dphi(int64_t off, int64_t NS, T * z1, T* signs, T* dphi) const
 {
+    uint64_t N = (uint64_t)NC_*NS;
+    scoped_phase phase(PHASE_DIST_DPHI, 2*N*sizeof(T), N*dphi_flops);
     if(cpu.HW_SSE3)
         dphi_sse3(off, NS, z1, signs, dphi);
     else
         dphi_fb(off, NS, z1, signs, dphi);
 }
 
+template<class T>
+bool has_fused_kernels(int64_t NC)
+{ return std::is_same<T, float>::value && NC <= fused_max_channels && cpu.HW_SSE3; }
+
+//Nominal cost of the fused kernels : the two (three) small GEMMs plus the nonlinearities
+template<class T, template<class> class F>
+bool dist<T, F>::fused_value_gradient(whitened_data<T> const & X, int64_t off, int64_t NS, T const * W, T const * signs, T * mu, T * phixT) const
+{
+    if(!has_fused_kernels<T>(NC_))
+        return false;
+    uint64_t N = (uint64_t)NC_*NS;
+    scoped_phase phase(PHASE_FUSED, N*X.element_size(), 4*N*NC_ + N*(logp_flops + phi_flops));
+    return fused_evaluate<F, false>(X, accuracy_, off, NS, W, (T const *)NULL, signs, mu, phixT);
+}
+
+template<class T, template<class> class F>
+bool dist<T, F>::fused_hv_product(whitened_data<T> const & X, int64_t off, int64_t NS, T const * W, T const * V, T const * signs, T * psixT) const
+{
+    if(!has_fused_kernels<T>(NC_))
+        return false;
+    uint64_t N = (uint64_t)NC_*NS;
+    scoped_phase phase(PHASE_FUSED, N*X.element_size(), 6*N*NC_ + N*(dphi_flops + 1));
+    return fused_evaluate<F, true>(X, accuracy_, off, NS, W, V, signs, (T *)NULL, psixT);
+}
+
 template class dist<float, infomax>;
 template class dist<double, infomax>;
 template class dist<float, extended_infomax>;
 template class dist<double, extended_infomax>;
+template bool has_fused_kernels<float>(int64_t);
+template bool has_fused_kernels<double>(int64_t);
 
 }
@@ -11,9 +11,22 @@
 #include "neo_ica/dist.h"
 #include "neo_ica/backend/backend.hpp"
 #include "neo_ica/tools/mex.hpp"
+#include "neo_ica/tools/arena.h"
+#include "neo_ica/tools/elementwise.hpp"
+#include "neo_ica/tools/layout.hpp"
+#include "neo_ica/tools/memory.h"
+#include "neo_ica/tools/numa.h"
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/pipeline.h"
+#include "neo_ica/tools/profiler.h"
+#include "neo_ica/tools/reduction.hpp"
+#include "neo_ica/tools/round.hpp"
 #include "neo_ica/tools/shuffle.hpp"
+#include "neo_ica/tools/threads.h"
 #include "neo_ica/tools/whiten.hpp"
 
+#include "lib/passes.hpp"
+
 #include "umintl/debug.hpp"
 #include "umintl/minimize.hpp"
 #include "umintl/stopping_criterion/parameter_change_threshold.hpp"
@@ -22,301 +35,16 @@
 #include "omp.h"
 
 #include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace neo_ica{
 
-inline int omp_thread_count() {
-    int n = 0;
-    #pragma omp parallel reduction(+:n)
-    n += 1;
-    return n;
-}
-
-template<class T>
-struct log_likelihood{
-    typedef T * VectorType;
-
-public:
-    log_likelihood(T const * data, int64_t NF, int64_t NC, dist_base<T>* fn) : data_(data), NC_(NC), NF_(NF), fn_(fn){
-        ipiv_ =  new typename backend<T>::size_t[NC_+1];
-
-        //NC*NF matrices
-        Z = new T[NC_*NF_];
-        RZ = new T[NC_*NF_];
-        datasq_ = new T[NC_*NF_];
-
-        //NC*NC matrices
-        psixT = new T[NC_*NC_];
-        phixT = new T[NC_*NC_];
-        wmT = new T[NC_*NC_];
-        W = new T[NC_*NC_];
-        WLU = new T[NC_*NC_];
-        V = new T[NC_*NC_];
-        HV = new T[NC_*NC_];
-        WinvV = new T[NC_*NC_];
-        mu = new T[NC_];
-        first_signs = new T[NC_];
-
-        for(int64_t i = 0 ; i < NC_; ++i)
-            for(int64_t j = 0; j < NF_; ++j)
-                datasq_[i*NF_+j] = data_[i*NF_+j]*data_[i*NF_+j];
-
-
-        for(int64_t c = 0 ; c < NC_ ; ++c){
-            T m2 = 0, m4 = 0;
-            for(int64_t f = 0; f < NF_ ; f++){
-                T X = data_[c*NF_+f];
-                m2 += std::pow(X,2);
-                m4 += std::pow(X,4);
-            }
-            m2 = std::pow(m2/NF_,2);
-            m4 = m4/NF_;
-            T k = m4/m2 - 3;
-            first_signs[c] = (T)((k+0.02>0)?1:-1);
-        }
-    }
-
-    bool resigns(T* x){
-        bool sign_change = false;
-        std::memcpy(W, x,sizeof(T)*NC_*NC_);
-        backend<T>::gemm(NoTrans,NoTrans,NF_,NC_,NC_,1,data_,NF_,W,NC_,0,Z,NF_);
-
-        for(int64_t c = 0 ; c < NC_ ; ++c){
-            T m2 = 0, m4 = 0;
-            //ScalarType b = b_[c];
-            for(int64_t f = 0; f < NF_ ; f++){
-                T X = Z[c*NF_+f];
-                m2 += std::pow(X,2);
-                m4 += std::pow(X,4);
-            }
-
-            m2 = std::pow(1/(T)NF_*m2,2);
-            m4 = 1/(T)NF_*m4;
-            T k = m4/m2 - 3;
-            int new_sign = (k+0.02>0)?1:-1;
-            sign_change |= (new_sign!=first_signs[c]);
-            first_signs[c] = new_sign;
-        }
-        return sign_change;
-    }
-
-    ~log_likelihood(){
-        delete[] ipiv_;
-        //NC*NF matrices
-        delete[] Z;
-        delete[] RZ;
-        delete[] datasq_;
-        //NC*NC matrices
-        delete[] psixT;
-        delete[] phixT;
-        delete[] wmT;
-        delete[] V;
-        delete[] HV;
-        delete[] W;
-        delete[] WLU;
-        delete[] WinvV;
-        delete[] mu;
-    }
-
-    /* Hessian-Vector product variance */
-    void operator()(VectorType const & x, VectorType const & v, VectorType & variance, umintl::hv_product_variance tag) const{
-        int64_t offset;
-        int64_t sample_size;
-        if(tag.model==umintl::DETERMINISTIC){
-          offset = 0;
-          sample_size = NF_;
-        }
-        else{
-          offset = tag.offset;
-          sample_size = tag.sample_size;
-        }
-
-        //Z = X*W
-        std::memcpy(W, x,sizeof(T)*NC_*NC_);
-        backend<T>::gemm(NoTrans,NoTrans,sample_size,NC_,NC_,1,data_+offset,NF_,W,NC_,0,Z+offset,NF_);
-
-        //RZ = X*V
-        std::memcpy(V, v,sizeof(T)*NC_*NC_);
-        backend<T>::gemm(NoTrans,NoTrans,sample_size,NC_,NC_,1,data_+offset,NF_,V,NC_,0,RZ+offset,NF_);
-
-        //Psi = dphi(Z).*RZ
-        //Reuse Z's buffer because not needed anymore after and elementwise
-        T* psi = Z;
-        T* dphi = Z;
-        fn_->dphi(offset,sample_size,Z,first_signs,dphi);
-        for(int64_t c = 0 ; c < NC_ ; ++c)
-            for(int64_t f = offset; f < offset+sample_size ; ++f)
-                psi[c*NF_+f] = dphi[c*NF_+f]*RZ[c*NF_+f];
-        backend<T>::gemm(Trans,NoTrans,NC_,NC_,sample_size ,1,data_+offset,NF_,psi+offset,NF_,0,psixT,NC_);
-
-
-        //Variance = 1/(N-1)[psi.^2*(x.^2)' - 1/N*psi*x']
-        for(int64_t i = 0 ; i < NC_; ++i)
-            for(int64_t j = offset ; j < offset+sample_size; ++j)
-                psi[i*NF_+j] = psi[i*NF_+j]*psi[i*NF_+j];
-        backend<T>::gemm(Trans,NoTrans,NC_,NC_,sample_size,1,datasq_+offset,NF_,psi+offset,NF_,0,variance,NC_);
-        for(int64_t i = 0 ; i < NC_; ++i)
-            for(int64_t j = 0 ; j < NC_; ++j)
-              variance[i*NC_+j] = (T)1/(sample_size-1)*(variance[i*NC_+j] - psixT[i*NC_+j]*psixT[i*NC_+j]/(T)sample_size);
-    }
-
-    /* Hessian-Vector product */
-    void operator()(VectorType const & x, VectorType const & v, VectorType & Hv, umintl::hessian_vector_product tag) const{
-        int64_t offset;
-        int64_t sample_size;
-        if(tag.model==umintl::DETERMINISTIC){
-          offset = 0;
-          sample_size = NF_;
-        }
-        else{
-          offset = tag.offset;
-          sample_size = tag.sample_size;
-        }
-
-        std::memcpy(W, x,sizeof(T)*NC_*NC_);
-
-        //Z = X*W
-        backend<T>::gemm(NoTrans,NoTrans,sample_size,NC_,NC_,1,data_+offset,NF_,W,NC_,0,Z+offset,NF_);
-
-        //RZ = X*V
-        std::memcpy(V, v,sizeof(T)*NC_*NC_);
-        backend<T>::gemm(NoTrans,NoTrans,sample_size,NC_,NC_,1,data_+offset,NF_,V,NC_,0,RZ+offset,NF_);
-
-        //Psi = dphi(Z).*RZ
-        //Reuse Z's buffer because not needed anymore after and elementwise
-        T* psi = Z;
-        T* dphi = Z;
-        fn_->dphi(offset,sample_size,Z,first_signs,dphi);
-        for(int64_t c = 0 ; c < NC_ ; ++c)
-            for(int64_t f = offset; f < offset+sample_size ; ++f)
-                psi[c*NF_+f] = dphi[c*NF_+f]*RZ[c*NF_+f];
-
-        //HV = (inv(W)*V*inv(w))' + 1/n*Psi*X'
-        std::memcpy(WLU,x,sizeof(T)*NC_*NC_);
-        backend<T>::getrf(NC_,NC_,WLU,NC_,ipiv_);
-        backend<T>::getri(NC_,WLU,NC_,ipiv_);
-        backend<T>::gemm(Trans,Trans,NC_,NC_,NC_ ,1,WLU,NC_,V,NC_,0,WinvV,NC_);
-        backend<T>::gemm(NoTrans,Trans,NC_,NC_,NC_ ,1,WinvV,NC_,WLU,NC_,0,HV,NC_);
-        backend<T>::gemm(Trans,NoTrans,NC_,NC_,sample_size ,1,data_+offset,NF_,psi+offset,NF_,0,psixT,NC_);
-
-        //Copy back
-        for(int64_t i = 0 ; i < NC_*NC_; ++i)
-            Hv[i] = HV[i] + psixT[i]/(T)sample_size;
-    }
-
-    /* Gradient variance */
-    void operator()(VectorType const & x, VectorType & variance, umintl::gradient_variance tag){
-        int64_t offset;
-        int64_t sample_size;
-        if(tag.model==umintl::DETERMINISTIC){
-          offset = 0;
-          sample_size = NF_;
-        }
-        else{
-          offset = tag.offset;
-          sample_size = tag.sample_size;
-        }
-
-        std::memcpy(W, x,sizeof(T)*NC_*NC_);
-
-        backend<T>::gemm(NoTrans,NoTrans,sample_size,NC_,NC_,1,data_+offset,NF_,W,NC_,0,Z+offset,NF_);
-
-        T* phi = Z;
-        fn_->phi(offset,sample_size,Z,first_signs,phi);
-        backend<T>::gemm(Trans,NoTrans,NC_,NC_,sample_size ,1,data_+offset,NF_,phi+offset,NF_,0,phixT,NC_);
-
-        //GradVariance = 1/(N-1)[phi.^2*(x.^2)' - 1/N*phi*x']
-        for(int64_t i = 0 ; i < NC_; ++i)
-            for(int64_t j = offset ; j < offset+sample_size; ++j)
-                phi[i*NF_+j] = phi[i*NF_+j]*phi[i*NF_+j];
-        backend<T>::gemm(Trans,NoTrans,NC_,NC_,sample_size,1,datasq_+offset,NF_,phi+offset,NF_,0,variance,NC_);
-        for(int64_t i = 0 ; i < NC_; ++i)
-            for(int64_t j = 0 ; j < NC_; ++j)
-              variance[i*NC_+j] = (T)1/(sample_size-1)*(variance[i*NC_+j] - phixT[i*NC_+j]*phixT[i*NC_+j]/(T)sample_size);
-    }
-
-    /* Gradient */
-    void operator()(VectorType const & x, T& value, VectorType & grad, umintl::value_gradient tag) const {
-        throw_if_mex_and_ctrl_c();
-
-        int64_t offset;
-        int64_t sample_size;
-        if(tag.model==umintl::DETERMINISTIC){
-          offset = 0;
-          sample_size = NF_;
-        }
-        else{
-          offset = tag.offset;
-          sample_size = tag.sample_size;
-        }
-
-        //Rerolls the variables into the appropriates datastructures
-        std::memcpy(W, x,sizeof(T)*NC_*NC_);
-
-        //Z = X*W;
-        backend<T>::gemm(NoTrans,NoTrans,sample_size,NC_,NC_,1,data_+offset,NF_,W,NC_,0,Z+offset,NF_);
-
-        //mu = mean(mata.*abs(Z).^(mata-1).*sign(Z),2);
-        fn_->mu(offset,sample_size,Z,first_signs,mu);
-
-        //LU Decomposition
-        std::memcpy(WLU,W,sizeof(T)*NC_*NC_);
-        backend<T>::getrf(NC_,NC_,WLU,NC_,ipiv_);
-
-        //H = log(abs(det(w))) + sum(mu);
-        T logabsdet = 0;
-        for(int64_t i = 0 ; i < NC_ ; ++i)
-            logabsdet += std::log(std::abs(WLU[i*NC_+i]));
-        T H = logabsdet;
-        for(int64_t i = 0; i < NC_ ; ++i)
-            H+=mu[i];
-
-        //dweights = W^-T - 1/n*Phi*X'
-        T* phi = Z;
-        fn_->phi(offset,sample_size,Z,first_signs,phi);
-        backend<T>::gemm(Trans,NoTrans,NC_,NC_,sample_size ,1,data_+offset,NF_,phi+offset,NF_,0,phixT,NC_);
-        backend<T>::getri(NC_,WLU,NC_,ipiv_);
-        for(int64_t i = 0 ; i < NC_; ++i)
-            for(int64_t j = 0 ; j < NC_; ++j)
-                wmT[i*NC_+j] = WLU[j*NC_+i];
-
-        //Reverse sign and copy
-        value = -H;
-        for(int64_t i = 0 ; i < NC_*NC_; ++i)
-          grad[i] = - (wmT[i] - phixT[i]/sample_size);
-    }
-
-private:
-    T const * data_;
-    T * first_signs;
-
-    int64_t NC_;
-    int64_t NF_;
-
-
-    typename backend<T>::size_t *ipiv_;
-
-
-    T* Z ;
-    T* RZ;
-
-    T* phixT;
-    T* psixT;
-
-    T* datasq_;
-
-    T* wmT;
-    T* V;
-    T* HV;
-    T* WinvV;
-    T* W;
-    T* WLU;
-    T* mu;
-
-    std::shared_ptr<dist_base<T>> fn_;
-};
-
 template<class BackendType>
 class stop_ica: public umintl::stopping_criterion<BackendType>
 {
@@ -349,10 +77,27 @@ private:
 
 //lim = max(abs(abs(np.diag(fast_dot(W1, W.T))) - 1))
 
+inline void dump_trace(options const & opt){
+    std::ofstream out(opt.trace_file.c_str());
+    if(!out)
+        throw neo_ica::exception("Cannot open trace file " + opt.trace_file);
+    tools::tracer::get().to_json(out);
+}
+
+inline void dump_profile(options const & opt){
+    tools::profiler & prof = tools::profiler::get();
+    if(opt.profile_file.empty())
+        prof.to_json(std::cout);
+    else{
+        std::ofstream out(opt.profile_file.c_str());
+        if(!out)
+            throw neo_ica::exception("Cannot open profile file " + opt.profile_file);
+        prof.to_json(out);
+    }
+}
+
 template<class T>
 void ica(T const * data, T* Weights, T* Sphere, int64_t NC, int64_t DataNF, options const & conf){
-    typedef typename umintl_backend<T>::type BackendType;
-
     options opt(conf);
 
 
@@ -363,46 +108,100 @@ void ica(T const * data, T* Weights, T* Sphere, int64_t NC, int64_t DataNF, opti
     opt.fbatch=std::min(opt.fbatch, (size_t)NF);
     if(opt.fbatch==0)
         opt.fbatch=NF;
+    //The single precision options then apply to the first pass
+    bool mixed = opt.mixed_precision && std::is_same<T, double>::value;
+
+    //Threads
+    tools::scoped_thread_budget budget(opt.nthreads);
+    if(opt.verbose >= 1)
+        std::cout << budget.description() << std::endl;
+    tools::scoped_thread_affinity affinity(opt.pin_threads);
+    if(opt.pin_threads && !affinity.pinned() && opt.verbose >= 1)
+        std::cout << "Could not pin the threads" << std::endl;
+    if(opt.pipeline && budget.threads() < 2 && opt.verbose >= 1)
+        std::cout << "Pipelined evaluation needs at least two threads" << std::endl;
+
+    data_format format = choose_format<T>(NC, opt, opt.verbose >= 1 && !mixed);
 
     //Allocate
-    T * white_data =  new T[NC*NF];
+    tools::memory_plan plan = tools::plan_memory(NC, NF, sizeof(T), opt.max_memory, format.blocked, tools::storage_size(format.storage));
+    tools::memory_tracker & tracker = tools::memory_tracker::get();
+    tracker.reset();
+    tools::arena & arena = tools::arena::get();
+    arena.huge_pages(opt.huge_pages);
+    arena.prefault(opt.prefault);
+    tools::buffer<T> native_buffer;
+    tools::buffer<uint16_t> compact_buffer;
+    tools::whitened_data<T> whitened = allocate_whitened<T>(NC, NF, format, native_buffer, compact_buffer);
     T * X = new T[N];
     std::memset(X,0,N*sizeof(T));
+    if(opt.verbose >= 1 && plan.tile < NF)
+        std::cout << "Memory budget: objective evaluated over tiles of " << plan.tile << " frames" << std::endl;
+
+    tools::profiler & prof = tools::profiler::get();
+    prof.reset();
+    prof.enable(opt.profile);
+    tools::hardware_counters & counters = tools::hardware_counters::get();
+    if(opt.profile && opt.hardware_counters && !counters.open() && opt.verbose >= 1)
+        std::cout << "Hardware counters " << counters.status() << std::endl;
+    tools::tracer & tracer = tools::tracer::get();
+    tracer.enable(!opt.trace_file.empty());
 
     //Whiten Data
-    whiten<T>(NC, DataNF, NF, data, Sphere, white_data);
-    shuffle(white_data,NC,NF);
-
-    //Objective
-    dist_base<T>* fn;
-    if(opt.extended)
-        fn = new dist<T, extended_infomax>(NC, NF);
-    else
-        fn = new dist<T, infomax>(NC, NF);
-    log_likelihood<T> objective(white_data,NF,NC,fn);
+    if(!whitened.direct()){
+        //Shuffled while whitened
+        tools::buffer<size_t> perms(NF, tools::MEMORY_SHUFFLE);
+        {
+            tools::scoped_phase phase(tools::PHASE_SHUFFLE, NF*sizeof(size_t));
+            shuffle_permutation(NF, perms.get());
+        }
+        tools::scoped_phase phase(tools::PHASE_WHITEN);
+        whiten_shuffled<T>(NC, DataNF, data, perms.get(), Sphere, whitened);
+    }
+    else{
+        {
+            tools::scoped_phase phase(tools::PHASE_WHITEN);
+            whiten<T>(NC, DataNF, NF, data, Sphere, native_buffer.get());
+        }
+        tools::scoped_phase phase(tools::PHASE_SHUFFLE, 2*(uint64_t)NC*NF*sizeof(T) + NF*sizeof(size_t));
+        shuffle(native_buffer.get(),NC,NF);
+    }
 
     //Initial guess W_0 = I
     for(int64_t i = 0 ; i < NC; ++i)
         X[i*(NC+1)] = 1;
 
-    //Optimizer
-    umintl::minimizer<BackendType> minimizer;
-    minimizer.hessian_vector_product_computation = umintl::PROVIDED;
-    minimizer.model = new umintl::dynamically_sampled<BackendType>(opt.rho,opt.fbatch,NF,opt.theta);
-
-    minimizer.direction = new umintl::truncated_newton<BackendType>(umintl::tag::truncated_newton::STOP_HV_VARIANCE);
-    minimizer.verbose = opt.verbose;
-    minimizer.iter = opt.iter;
-    minimizer.stopping_criterion = new umintl::parameter_change_threshold<BackendType>(opt.tol);
-    do{
-        minimizer(X,objective,X,N);
-    }while(opt.extended && objective.resigns(X));
+    //Optimizer, on a coreset first if requested, then in single precision first if mixed
+    bool coreset = opt.coreset_fraction > 0 && opt.coreset_fraction < 1 && coreset_pass(whitened, X, opt);
+    if(coreset)
+        opt.iter = opt.coreset_polish;
+    sampling_state sampling;
+    if(mixed && opt.iter > 0)
+        coarse_pass(whitened, X, opt, sampling);
+    if(opt.iter > 0){
+        log_likelihood<T> objective(whitened,make_dist<T>(opt.extended, NC, plan.ld, opt.accuracy),plan,opt.pipeline,opt.fused_kernels);
+        //Signs at the escalation point rather than those of the data
+        if(opt.extended && (sampling.resume || coreset))
+            objective.resigns(X);
+        optimize(objective, X, NC, NF, opt, opt.tol, sampling);
+    }
 
     //Copies into datastructures
     std::memcpy(Weights, X,sizeof(T)*NC*NC);
 
     delete[] X;
-    delete[] white_data;
+
+    if(opt.verbose >= 1)
+        tracker.print(std::cout);
+
+    prof.enable(false);
+    if(opt.profile)
+        dump_profile(opt);
+    counters.close();
+    if(tracer.enabled()){
+        tracer.enable(false);
+        dump_trace(opt);
+    }
 }
 
 template void ica<float>(float const * data, float* Weights, float* Sphere, int64_t NC, int64_t NF, neo_ica::options const & opt);
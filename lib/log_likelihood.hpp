@@ -0,0 +1,905 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_LOG_LIKELIHOOD_HPP_
+#define NEO_ICA_LOG_LIKELIHOOD_HPP_
+
+#include "neo_ica/ica.h"
+#include "neo_ica/dist.h"
+#include "neo_ica/backend/backend.hpp"
+#include "neo_ica/tools/mex.hpp"
+#include "neo_ica/tools/arena.h"
+#include "neo_ica/tools/elementwise.hpp"
+#include "neo_ica/tools/layout.hpp"
+#include "neo_ica/tools/memory.h"
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/pipeline.h"
+#include "neo_ica/tools/profiler.h"
+#include "neo_ica/tools/reduction.hpp"
+#include "neo_ica/tools/round.hpp"
+
+#include "umintl/forwards.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+//Objective of the optimization, internal to the library
+
+namespace neo_ica{
+
+//Pipelined evaluation : enough items to keep the stages busy, items long enough to amortize the queues
+static const int64_t pipeline_items_per_thread = 4;
+static const int64_t pipeline_min_chunk = 512;
+
+//Early exit of the line search : blocks of a trial evaluation, smallest block
+static const int64_t early_exit_blocks = 8;
+static const int64_t early_exit_min_frames = 1024;
+
+//Components being optimized : those whose gradient column is below tol are frozen, until all thaw every period iterations
+struct active_set{
+    active_set(int64_t NC, double tol, size_t period) : NC(NC), tol(tol), period(period), iter(0), last_check(0), version(0), frozen(NC, false){
+        for(int64_t j = 0 ; j < NC ; ++j)
+            active.push_back(j);
+    }
+
+    bool any_frozen() const { return !inactive.empty(); }
+
+    //Called at the start of each iteration with the gradient, full when no component is frozen
+    template<class T>
+    void update(T const * g, unsigned int verbose){
+        size_t current = iter++;
+        if(tol <= 0)
+            return;
+        if(any_frozen()){
+            if(current - last_check >= period){
+                thaw();
+                if(verbose > 0)
+                    std::cout << "Re-activating all components" << std::endl;
+            }
+            return;
+        }
+        std::vector<bool> converged(NC);
+        int64_t n = 0;
+        for(int64_t j = 0 ; j < NC ; ++j){
+            double norm = 0;
+            for(int64_t i = 0 ; i < NC ; ++i)
+                norm += (double)g[j*NC + i]*g[j*NC + i];
+            converged[j] = std::sqrt(norm) < tol;
+            n += converged[j];
+        }
+        //All converged is left to the stopping criterion
+        if(n==0 || n==NC)
+            return;
+        frozen = converged;
+        last_check = current;
+        rebuild();
+        if(verbose > 0)
+            std::cout << "Freezing " << n << " of " << NC << " components" << std::endl;
+    }
+
+    void thaw(){
+        std::fill(frozen.begin(), frozen.end(), false);
+        rebuild();
+    }
+
+    //Zeroes the entries of the frozen components in the NC*NC matrix M
+    template<class T>
+    void mask(T * M) const{
+        for(int64_t j : inactive)
+            std::fill(M + j*NC, M + (j+1)*NC, 0);
+    }
+
+    int64_t NC;
+    double tol;
+    size_t period;
+    size_t iter;
+    size_t last_check;
+    //Incremented whenever the set changes
+    size_t version;
+    std::vector<bool> frozen;
+    //Indices of the active and frozen components, ascending
+    std::vector<int64_t> active;
+    std::vector<int64_t> inactive;
+
+private:
+    void rebuild(){
+        active.clear();
+        inactive.clear();
+        for(int64_t j = 0 ; j < NC ; ++j)
+            (frozen[j]?inactive:active).push_back(j);
+        ++version;
+    }
+};
+
+//Adds the lifetime of the object to total, in seconds
+class scoped_timer{
+    typedef std::chrono::steady_clock clock;
+public:
+    scoped_timer(double & total) : total_(total), start_(clock::now()){ }
+    ~scoped_timer(){ total_ += std::chrono::duration<double>(clock::now() - start_).count(); }
+private:
+    double & total_;
+    clock::time_point start_;
+};
+
+template<class T>
+struct log_likelihood{
+    typedef T * VectorType;
+
+public:
+    log_likelihood(tools::whitened_data<T> const & data, dist_base<T>* fn, tools::memory_plan const & plan, bool pipelined, bool fused) : data_(data), NC_(data.NC), NF_(data.NF), tile_(plan.tile), ld_(plan.ld), pipelined_(pipelined), fused_(fused), fn_(fn){
+        ipiv_ =  new typename backend<T>::size_t[NC_+1];
+
+        //NC*tile matrices
+        Z_.allocate(NC_, ld_, tools::MEMORY_OBJECTIVE);
+        RZ_.allocate(NC_, ld_, tools::MEMORY_OBJECTIVE);
+        Z = Z_.get();
+        RZ = RZ_.get();
+        if(!data_.direct())
+            staging_.allocate(NC_, ld_, tools::MEMORY_OBJECTIVE);
+        //The fused kernels never go through the cache
+        if(plan.cache_curvature && !(fused_ && has_fused_kernels<T>(NC_)))
+            curvature_cache_.allocate(NC_, ld_, tools::MEMORY_OBJECTIVE);
+        cached_W_.resize(NC_*NC_);
+        cached_offset_ = cached_size_ = cached_n_ = -1;
+        shared_inverse_ = false;
+        gradient_seconds_ = hv_seconds_ = 0;
+        W_gathered_.resize(NC_*NC_);
+        V_gathered_.resize(NC_*NC_);
+        signs_gathered_.resize(NC_);
+        subsets_.resize(NC_);
+        active_ = NULL;
+        frozen_size_ = -1;
+        datasq_ = NULL;
+        if(plan.cache_squares){
+            datasq_buffer_.allocate(NC_, NF_, tools::MEMORY_OBJECTIVE);
+            datasq_ = datasq_buffer_.get();
+        }
+
+        //NC*NC matrices
+        psixT = new T[NC_*NC_];
+        phixT = new T[NC_*NC_];
+        wmT = new T[NC_*NC_];
+        W = new T[NC_*NC_];
+        WLU = new T[NC_*NC_];
+        V = new T[NC_*NC_];
+        HV = new T[NC_*NC_];
+        WinvV = new T[NC_*NC_];
+        mu = new T[NC_];
+        mu_tile = new T[NC_];
+        first_signs = new T[NC_];
+        select(NULL);
+
+        tools::memory_tracker & tracker = tools::memory_tracker::get();
+        tracker.allocate(tools::MEMORY_PARAMETERS, parameter_bytes());
+
+        if(datasq_ && !data_.direct()){
+            data_.unpack(0, NF_, datasq_, NF_);
+            tools::square(NC_, NF_, datasq_, NF_, datasq_, NF_);
+        }
+        else if(datasq_)
+            tools::square(NC_, NF_, data_.native(), NF_, datasq_, NF_);
+
+        tools::parallel_for(0, NC_, 1, [&](int64_t begin, int64_t end){
+            for(int64_t c = begin ; c < end ; ++c){
+                double m2 = 0, m4 = 0;
+                for(int64_t f = 0; f < NF_ ; f++){
+                    double X2 = (double)data_.at(c, f)*data_.at(c, f);
+                    m2 += X2;
+                    m4 += X2*X2;
+                }
+                m2 = std::pow(m2/NF_,2);
+                m4 = m4/NF_;
+                double k = m4/m2 - 3;
+                first_signs[c] = (T)((k+0.02>0)?1:-1);
+            }
+        });
+    }
+
+    bool resigns(T* x){
+        bool sign_change = false;
+        cached_size_ = frozen_size_ = -1;
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        std::fill(mu, mu + NC_, 0);
+        std::fill(mu_tile, mu_tile + NC_, 0);
+        //m2 in mu, m4 in mu_tile
+        for(int64_t t = 0 ; t < NF_ ; t += tile_){
+            int64_t ns = std::min(tile_, NF_ - t);
+            int64_t ldx;
+            stage(t, ns, 0);
+            T const * X = frames(t, 0, ldx);
+            backend<T>::gemm(NoTrans,NoTrans,ns,NC_,NC_,1,X,ldx,W,NC_,0,Z,ld_);
+            tools::parallel_for(0, NC_, 1, [&](int64_t begin, int64_t end){
+                for(int64_t c = begin ; c < end ; ++c){
+                    for(int64_t f = 0; f < ns ; f++){
+                        T X2 = Z[c*ld_+f]*Z[c*ld_+f];
+                        mu[c] += X2;
+                        mu_tile[c] += X2*X2;
+                    }
+                }
+            });
+        }
+
+        for(int64_t c = 0 ; c < NC_ ; ++c){
+            T m2 = std::pow(1/(T)NF_*mu[c],2);
+            T m4 = 1/(T)NF_*mu_tile[c];
+            T k = m4/m2 - 3;
+            int new_sign = (k+0.02>0)?1:-1;
+            sign_change |= (new_sign!=first_signs[c]);
+            first_signs[c] = new_sign;
+        }
+        return sign_change;
+    }
+
+    ~log_likelihood(){
+        tools::memory_tracker & tracker = tools::memory_tracker::get();
+        tracker.release(tools::MEMORY_PARAMETERS, parameter_bytes());
+
+        delete[] ipiv_;
+        //NC*NC matrices
+        delete[] psixT;
+        delete[] phixT;
+        delete[] wmT;
+        delete[] V;
+        delete[] HV;
+        delete[] W;
+        delete[] WLU;
+        delete[] WinvV;
+        delete[] mu;
+        delete[] mu_tile;
+        delete[] first_signs;
+    }
+
+    /* Hessian-Vector product variance */
+    void operator()(VectorType const & x, VectorType const & v, VectorType & variance, umintl::hv_product_variance tag) const{
+        tools::scoped_phase phase(tools::PHASE_HV_PRODUCT_VARIANCE);
+        int64_t offset;
+        int64_t sample_size;
+        if(tag.model==umintl::DETERMINISTIC){
+          offset = 0;
+          sample_size = NF_;
+        }
+        else{
+          offset = tag.offset;
+          sample_size = tag.sample_size;
+        }
+        phase.annotate("sample_size", sample_size);
+
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        std::memcpy(V, v,sizeof(T)*NC_*NC_);
+        if(any_frozen())
+            select(&active_->active);
+        if(!cached_curvature(offset, sample_size, variance)){
+            sums totals;
+            totals.add(psixT, NC_*n_sel_);
+            totals.add(variance, NC_*n_sel_);
+            evaluate(offset, sample_size, true, totals, [&](int64_t t, int64_t ns, T const * X, int64_t ldx, T* Z, T* RZ, sums const & acc, T beta){
+                //Psi = dphi(Z).*RZ
+                curvature(ns, X, ldx, Z, RZ, beta, acc.ptr[0]);
+                //Variance = 1/(N-1)[psi.^2*(x.^2)' - 1/N*psi*x']
+                second_moment(t, ns, X, ldx, Z, RZ, beta, acc.ptr[1]);
+            });
+        }
+        if(any_frozen()){
+            expand(active_->active, psixT, NC_);
+            expand(active_->active, variance, NC_);
+            select(NULL);
+        }
+        for(int64_t i = 0 ; i < NC_; ++i)
+            for(int64_t j = 0 ; j < NC_; ++j)
+              variance[i*NC_+j] = (T)1/(sample_size-1)*(variance[i*NC_+j] - psixT[i*NC_+j]*psixT[i*NC_+j]/(T)sample_size);
+    }
+
+    /* Hessian-Vector product */
+    void operator()(VectorType const & x, VectorType const & v, VectorType & Hv, umintl::hessian_vector_product tag) const{
+        tools::scoped_phase phase(tools::PHASE_HV_PRODUCT);
+        scoped_timer timer(hv_seconds_);
+        int64_t offset;
+        int64_t sample_size;
+        if(tag.model==umintl::DETERMINISTIC){
+          offset = 0;
+          sample_size = NF_;
+        }
+        else{
+          offset = tag.offset;
+          sample_size = tag.sample_size;
+        }
+        phase.annotate("sample_size", sample_size);
+
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        std::memcpy(V, v,sizeof(T)*NC_*NC_);
+        //The fused kernels evaluate all the components
+        if(!fused_ || !fn_->fused_hv_product(data_, offset, sample_size, W, V, first_signs, psixT)){
+            if(any_frozen())
+                select(&active_->active);
+            if(!cached_curvature(offset, sample_size, NULL)){
+                sums totals;
+                totals.add(psixT, NC_*n_sel_);
+                evaluate(offset, sample_size, true, totals, [&](int64_t, int64_t ns, T const * X, int64_t ldx, T* Z, T* RZ, sums const & acc, T beta){
+                    //Psi = dphi(Z).*RZ
+                    curvature(ns, X, ldx, Z, RZ, beta, acc.ptr[0]);
+                });
+            }
+            if(any_frozen()){
+                expand(active_->active, psixT, NC_);
+                select(NULL);
+            }
+        }
+
+        //HV = (inv(W)*V*inv(w))' + 1/n*Psi*X'
+        inverse(x);
+        backend<T>::gemm(Trans,Trans,NC_,NC_,NC_ ,1,WLU,NC_,V,NC_,0,WinvV,NC_);
+        backend<T>::gemm(NoTrans,Trans,NC_,NC_,NC_ ,1,WinvV,NC_,WLU,NC_,0,HV,NC_);
+
+        //Copy back
+        for(int64_t i = 0 ; i < NC_*NC_; ++i)
+            Hv[i] = HV[i] + psixT[i]/(T)sample_size;
+        if(any_frozen())
+            active_->mask(Hv);
+    }
+
+    /* Gradient variance */
+    void operator()(VectorType const & x, VectorType & variance, umintl::gradient_variance tag){
+        tools::scoped_phase phase(tools::PHASE_GRADIENT_VARIANCE);
+        int64_t offset;
+        int64_t sample_size;
+        if(tag.model==umintl::DETERMINISTIC){
+          offset = 0;
+          sample_size = NF_;
+        }
+        else{
+          offset = tag.offset;
+          sample_size = tag.sample_size;
+        }
+        phase.annotate("sample_size", sample_size);
+
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        sums totals;
+        totals.add(phixT, NC_*NC_);
+        totals.add(variance, NC_*NC_);
+        evaluate(offset, sample_size, false, totals, [&](int64_t t, int64_t ns, T const * X, int64_t ldx, T* Z, T* RZ, sums const & acc, T beta){
+            score(ns, X, ldx, Z, beta, acc.ptr[0]);
+            //GradVariance = 1/(N-1)[phi.^2*(x.^2)' - 1/N*phi*x']
+            second_moment(t, ns, X, ldx, Z, RZ, beta, acc.ptr[1]);
+        });
+        for(int64_t i = 0 ; i < NC_; ++i)
+            for(int64_t j = 0 ; j < NC_; ++j)
+              variance[i*NC_+j] = (T)1/(sample_size-1)*(variance[i*NC_+j] - phixT[i*NC_+j]*phixT[i*NC_+j]/(T)sample_size);
+        if(any_frozen())
+            active_->mask(variance);
+    }
+
+    /* Gradient */
+    void operator()(VectorType const & x, T& value, VectorType & grad, umintl::value_gradient tag) const {
+        throw_if_mex_and_ctrl_c();
+        tools::scoped_phase phase(tools::PHASE_VALUE_GRADIENT);
+        scoped_timer timer(gradient_seconds_);
+
+        int64_t offset;
+        int64_t sample_size;
+        if(tag.model==umintl::DETERMINISTIC){
+          offset = 0;
+          sample_size = NF_;
+        }
+        else{
+          offset = tag.offset;
+          sample_size = tag.sample_size;
+        }
+        phase.annotate("sample_size", sample_size);
+
+        //Rerolls the variables into the appropriates datastructures
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        data_term(offset, sample_size);
+        finish(log_abs_det(), value, grad, sample_size);
+    }
+
+    //Gradient, given up with the estimate of the frames seen (*tag.read) once they alone exceed the bound, as logp <= 0
+    //This trips only on steps overshooting by more than the unseen share of the mean -sum(logp), ~1.4 per source
+    bool operator()(VectorType const & x, T& value, VectorType & grad, umintl::bounded_value_gradient tag) const {
+        throw_if_mex_and_ctrl_c();
+        tools::scoped_phase phase(tools::PHASE_VALUE_GRADIENT);
+        scoped_timer timer(gradient_seconds_);
+
+        int64_t offset;
+        int64_t sample_size;
+        if(tag.model==umintl::DETERMINISTIC){
+          offset = 0;
+          sample_size = NF_;
+        }
+        else{
+          offset = tag.offset;
+          sample_size = tag.sample_size;
+        }
+        phase.annotate("sample_size", sample_size);
+
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        T logabsdet = log_abs_det();
+        int64_t nblocks = std::min<int64_t>(early_exit_blocks, sample_size/early_exit_min_frames);
+        if(nblocks < 2){
+            data_term(offset, sample_size);
+            finish(logabsdet, value, grad, sample_size);
+            return true;
+        }
+
+        std::vector<T> mu_sum(NC_, 0), phixT_sum(NC_*NC_, 0);
+        //Sum of sum(logp) over the frames seen
+        double total = 0;
+        int64_t seen = 0;
+        for(int64_t b = 0 ; b < nblocks ; ++b){
+            int64_t begin = offset + b*sample_size/nblocks, ns = offset + (b+1)*sample_size/nblocks - begin;
+            data_term(begin, ns);
+            for(int64_t j = 0 ; j < NC_ ; ++j){
+                mu_sum[j] += mu[j]*ns/sample_size;
+                total += (double)mu[j]*ns;
+            }
+            for(int64_t i = 0 ; i < NC_*NC_ ; ++i)
+                phixT_sum[i] += phixT[i];
+            seen += ns;
+
+            if(b < nblocks - 1 && -(logabsdet + total/sample_size) > tag.bound){
+                value = -(logabsdet + (T)(total/seen));
+                if(tag.read)
+                    *tag.read = seen;
+                phase.annotate("early_exit", b + 1);
+                return false;
+            }
+        }
+        std::copy(mu_sum.begin(), mu_sum.end(), mu);
+        std::copy(phixT_sum.begin(), phixT_sum.end(), phixT);
+        finish(logabsdet, value, grad, sample_size);
+        return true;
+    }
+
+private:
+    //mu and phixT over the frames [offset, offset+sample_size), of the parameters in W
+    void data_term(int64_t offset, int64_t sample_size) const{
+        if(!fused_ || !fn_->fused_value_gradient(data_, offset, sample_size, W, first_signs, mu, phixT)){
+            if(any_frozen()){
+                frozen_value(offset, sample_size);
+                select(&active_->active);
+            }
+            sums totals;
+            totals.add(phixT, NC_*n_sel_);
+            totals.add(mu, n_sel_);
+            evaluate(offset, sample_size, false, totals, [&](int64_t, int64_t ns, T const * X, int64_t ldx, T* Z, T*, sums const & acc, T beta){
+                mean_logp(ns, sample_size, Z, beta, acc.ptr[1]);
+                //dweights = W^-T - 1/n*Phi*X'
+                score(ns, X, ldx, Z, beta, acc.ptr[0]);
+            });
+            if(any_frozen()){
+                expand(active_->active, phixT, NC_);
+                expand(active_->active, mu, 1);
+                for(size_t k = 0 ; k < active_->inactive.size() ; ++k)
+                    mu[active_->inactive[k]] = frozen_mu_[k];
+                select(NULL);
+            }
+        }
+    }
+
+    //inv(W) into WLU
+    void inverse(T const * x) const{
+        if(shared_inverse_)
+            return;
+        std::memcpy(WLU,x,sizeof(T)*NC_*NC_);
+        backend<T>::getrf(NC_,NC_,WLU,NC_,ipiv_);
+        backend<T>::getri(NC_,WLU,NC_,ipiv_);
+    }
+
+    //LU decomposition of W into WLU, returns log(abs(det(W)))
+    T log_abs_det() const{
+        if(shared_inverse_)
+            return shared_logabsdet_;
+        std::memcpy(WLU,W,sizeof(T)*NC_*NC_);
+        backend<T>::getrf(NC_,NC_,WLU,NC_,ipiv_);
+        T logabsdet = 0;
+        for(int64_t i = 0 ; i < NC_ ; ++i)
+            logabsdet += std::log(std::abs(WLU[i*NC_+i]));
+        return logabsdet;
+    }
+
+    //Value and gradient from the data term and the LU decomposition of W
+    void finish(T logabsdet, T& value, VectorType & grad, int64_t sample_size) const{
+        //H = log(abs(det(w))) + sum(mu);
+        T H = logabsdet;
+        for(int64_t i = 0; i < NC_ ; ++i)
+            H+=mu[i];
+
+        if(!shared_inverse_)
+            backend<T>::getri(NC_,WLU,NC_,ipiv_);
+        for(int64_t i = 0 ; i < NC_; ++i)
+            for(int64_t j = 0 ; j < NC_; ++j)
+                wmT[i*NC_+j] = WLU[j*NC_+i];
+
+        //Reverse sign and copy
+        value = -H;
+        for(int64_t i = 0 ; i < NC_*NC_; ++i)
+          grad[i] = - (wmT[i] - phixT[i]/sample_size);
+        if(any_frozen())
+            active_->mask(grad);
+    }
+
+public:
+    //Leaves the frozen components of the given set out of the evaluations, NULL to evaluate all of them
+    void components(active_set const * active){
+        active_ = active;
+        frozen_size_ = -1;
+    }
+
+    //inv(W) and log|det(W)| of x, returned, for all the evaluations until release_inverse()
+    T share_inverse(T const * x) const{
+        shared_inverse_ = false;
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        shared_logabsdet_ = log_abs_det();
+        backend<T>::getri(NC_,WLU,NC_,ipiv_);
+        shared_inverse_ = true;
+        return shared_logabsdet_;
+    }
+
+    void release_inverse() const{
+        shared_inverse_ = false;
+    }
+
+    //Importance of each frame for the gradient, |phi(z)|*|x| with z = W'*x, into scores (NF)
+    void frame_scores(T const * x, T * scores) const{
+        std::memcpy(W, x,sizeof(T)*NC_*NC_);
+        sums none;
+        //|phi(z)|^2 goes to the scores and |x|^2 to the first row of RZ, unused without V
+        evaluate(0, NF_, false, none, [&](int64_t t, int64_t ns, T const * X, int64_t ldx, T* Z, T* RZ, sums const &, T){
+            fn_->phi(0,ns,Z,first_signs,Z);
+            T * phi2 = scores + t, * x2 = RZ;
+            std::fill(phi2, phi2 + ns, 0);
+            std::fill(x2, x2 + ns, 0);
+            for(int64_t j = 0 ; j < NC_ ; ++j)
+                for(int64_t f = 0 ; f < ns ; ++f){
+                    phi2[f] += Z[j*ld_ + f]*Z[j*ld_ + f];
+                    x2[f] += X[j*ldx + f]*X[j*ldx + f];
+                }
+            for(int64_t f = 0 ; f < ns ; ++f)
+                phi2[f] = std::sqrt(phi2[f]*x2[f]);
+        });
+    }
+
+    //Reorders the frames of the data (see tools::permute), which drops what was cached about them
+    void permute(int64_t const * perm){
+        tools::permute(data_, perm);
+        cached_offset_ = cached_size_ = cached_n_ = -1;
+        frozen_size_ = -1;
+    }
+
+    //Wall time spent in the value-gradient evaluations and in the Hessian-vector products so far
+    double gradient_seconds() const { return gradient_seconds_; }
+    double hv_seconds() const { return hv_seconds_; }
+
+private:
+    //Sums accumulated over the tiles of one evaluation
+    struct sums{
+        sums() : n(0){}
+        void add(T* p, int64_t s){ ptr[n] = p; size[n] = s; ++n; }
+        T* ptr[2];
+        int64_t size[2];
+        int n;
+    };
+
+    /* Evaluates over the frames [offset, offset+sample_size), tile by tile. Each tile X is projected, Z = X*W
+     * (and RZ = X*V if with_v), then consume(t, ns, X, ldx, Z, RZ, acc, beta) adds its contribution to the sums
+     * (beta is 0 for the first tile, which overwrites them). Data that is frame-blocked or stored in 16 bits
+     * is unpacked tile by tile into the staging buffer, split into slots like Z and RZ.
+     * In pipelined mode, the Z and RZ buffers are split into slots of a few frames : some workers project
+     * while the others consume into private sums, reduced in thread order at the end */
+    template<class Consume>
+    void evaluate(int64_t offset, int64_t sample_size, bool with_v, sums const & acc, Consume const & consume) const{
+        int nthreads = tools::thread_pool::get().size();
+        int64_t alignment = tools::arena_alignment/sizeof(T);
+        int64_t chunk = tools::round_to_next_multiple<int64_t>(std::max<int64_t>((sample_size + pipeline_items_per_thread*nthreads - 1)/(pipeline_items_per_thread*nthreads), pipeline_min_chunk), alignment);
+        int64_t n_slots = std::min<int64_t>(2*nthreads, ld_/chunk);
+        if(!pipelined_ || nthreads < 2 || n_slots < 2 || sample_size <= chunk){
+            for(int64_t t = offset ; t < offset + sample_size ; t += tile_){
+                int64_t ns = std::min(tile_, offset + sample_size - t);
+                int64_t ldx;
+                stage(t, ns, 0);
+                T const * X = frames(t, 0, ldx);
+                project(ns, X, ldx, with_v, Z, RZ);
+                consume(t, ns, X, ldx, Z, RZ, acc, (T)((t==offset)?0:1));
+            }
+            return;
+        }
+
+        tools::scoped_phase phase(tools::PHASE_PIPELINE, (uint64_t)(NC_ + n_sel_)*sample_size*sizeof(T)*(with_v?2:1), 2*(uint64_t)NC_*n_sel_*sample_size*(with_v?3:2));
+        //The workers issue their own GEMMs
+        tools::scoped_blas_threads blas(1);
+        int64_t stride = 0;
+        for(int i = 0 ; i < acc.n ; ++i)
+            stride += acc.size[i];
+        std::vector<T> partial(nthreads*stride, 0);
+        std::vector<sums> private_acc(nthreads);
+        for(int tid = 0 ; tid < nthreads ; ++tid){
+            int64_t off = 0;
+            for(int i = 0 ; i < acc.n ; off += acc.size[i++])
+                private_acc[tid].add(&partial[tid*stride + off], acc.size[i]);
+        }
+
+        tools::pipeline pipe((sample_size + chunk - 1)/chunk, (int)n_slots);
+        pipe.run([&](int64_t item, int slot, int){
+            int64_t t = offset + item*chunk;
+            int64_t ns = std::min(chunk, offset + sample_size - t), ldx;
+            stage(t, ns, slot*chunk);
+            T const * X = frames(t, slot*chunk, ldx);
+            project(ns, X, ldx, with_v, Z + slot*chunk, RZ + slot*chunk);
+        }, [&](int64_t item, int slot, int tid){
+            int64_t t = offset + item*chunk;
+            int64_t ldx;
+            T const * X = frames(t, slot*chunk, ldx);
+            consume(t, std::min(chunk, offset + sample_size - t), X, ldx, Z + slot*chunk, RZ + slot*chunk, private_acc[tid], (T)1);
+        });
+
+        int64_t off = 0;
+        for(int i = 0 ; i < acc.n ; off += acc.size[i++])
+            for(int64_t j = 0 ; j < acc.size[i] ; ++j){
+                T sum = 0;
+                for(int tid = 0 ; tid < nthreads ; ++tid)
+                    sum += partial[tid*stride + off + j];
+                acc.ptr[i][j] = sum;
+            }
+    }
+
+    bool any_frozen() const
+    { return active_ && active_->any_frozen(); }
+
+    //Restricts the next evaluations to the given components (all if NULL), whose sums are then packed in order
+    void select(std::vector<int64_t> const * columns) const{
+        if(!columns){
+            n_sel_ = NC_;
+            W_sel_ = W;
+            V_sel_ = V;
+            signs_sel_ = first_signs;
+            fn_sel_ = fn_.get();
+            return;
+        }
+        n_sel_ = columns->size();
+        for(int64_t k = 0 ; k < n_sel_ ; ++k){
+            int64_t j = (*columns)[k];
+            std::copy(W + j*NC_, W + (j+1)*NC_, W_gathered_.begin() + k*NC_);
+            std::copy(V + j*NC_, V + (j+1)*NC_, V_gathered_.begin() + k*NC_);
+            signs_gathered_[k] = first_signs[j];
+        }
+        if(!subsets_[n_sel_])
+            subsets_[n_sel_].reset(fn_->subset(n_sel_));
+        W_sel_ = W_gathered_.data();
+        V_sel_ = V_gathered_.data();
+        signs_sel_ = signs_gathered_.data();
+        fn_sel_ = subsets_[n_sel_].get();
+    }
+
+    //Moves the first columns of M, of the given rows, to those of the selected columns, and zeroes the others
+    void expand(std::vector<int64_t> const & columns, T* M, int64_t rows) const{
+        for(int64_t k = (int64_t)columns.size() - 1 ; k >= 0 ; --k)
+            if(columns[k]!=k)
+                std::copy(M + k*rows, M + (k+1)*rows, M + columns[k]*rows);
+        size_t k = 0;
+        for(int64_t j = 0 ; j < NC_ ; ++j){
+            if(k < columns.size() && columns[k]==j)
+                ++k;
+            else
+                std::fill(M + j*rows, M + (j+1)*rows, 0);
+        }
+    }
+
+    //mu = beta*mu + the contribution of the ns frames of Z to the mean of logp over sample_size frames
+    void mean_logp(int64_t ns, int64_t sample_size, T* Z, T beta, T* mu) const{
+        //mu = mean(mata.*abs(Z).^(mata-1).*sign(Z),2);
+        std::vector<T> mu_tile(n_sel_);
+        fn_sel_->mu(0,ns,Z,signs_sel_,mu_tile.data());
+        for(int64_t c = 0 ; c < n_sel_ ; ++c)
+            mu[c] = ((beta==0)?0:mu[c]) + mu_tile[c]*ns/sample_size;
+    }
+
+    //mu of the frozen components into frozen_mu_, once per window since their columns of W do not change
+    void frozen_value(int64_t offset, int64_t sample_size) const{
+        if(offset==frozen_offset_ && sample_size==frozen_size_ && active_->version==frozen_version_)
+            return;
+        select(&active_->inactive);
+        frozen_mu_.resize(n_sel_);
+        sums totals;
+        totals.add(frozen_mu_.data(), n_sel_);
+        evaluate(offset, sample_size, false, totals, [&](int64_t, int64_t ns, T const *, int64_t, T* Z, T*, sums const & acc, T beta){
+            mean_logp(ns, sample_size, Z, beta, acc.ptr[0]);
+        });
+        frozen_offset_ = offset;
+        frozen_size_ = sample_size;
+        frozen_version_ = active_->version;
+        select(NULL);
+    }
+
+    //Unpacks the frames [t, t+ns) into the staging buffer from the given column on, unless the data is used in place
+    void stage(int64_t t, int64_t ns, int64_t column) const{
+        if(!data_.direct())
+            data_.unpack(t, ns, staging_.get() + column, ld_);
+    }
+
+    //Channel-major frames from t on : the data itself, or their copy made by stage()
+    T const * frames(int64_t t, int64_t column, int64_t & ldx) const{
+        ldx = data_.direct()?NF_:ld_;
+        return data_.direct()?data_.native() + t:staging_.get() + column;
+    }
+
+    //Frame of X, returned by frames(), in the rows of its buffer : the reductions split the work along them
+    int64_t frame_of(T const * X) const
+    { return X - (data_.direct()?data_.native():staging_.get()); }
+
+    //Z = X*W, and RZ = X*V if with_v, over the ns frames of X
+    void project(int64_t ns, T const * X, int64_t ldx, bool with_v, T* Z, T* RZ) const{
+        backend<T>::gemm(NoTrans,NoTrans,ns,n_sel_,NC_,1,X,ldx,W_sel_,NC_,0,Z,ld_);
+        if(with_v)
+            backend<T>::gemm(NoTrans,NoTrans,ns,n_sel_,NC_,1,X,ldx,V_sel_,NC_,0,RZ,ld_);
+    }
+
+    //Z = phi(Z), phixT = beta*phixT + X'*phi
+    void score(int64_t ns, T const * X, int64_t ldx, T* Z, T beta, T* phixT) const{
+        fn_sel_->phi(0,ns,Z,signs_sel_,Z);
+        tools::tall_skinny_product(NC_,n_sel_,ns,(T)1,X,ldx,Z,ld_,beta,phixT,frame_of(X));
+    }
+
+    //Z = dphi(Z).*RZ, psixT = beta*psixT + X'*psi
+    void curvature(int64_t ns, T const * X, int64_t ldx, T* Z, T const * RZ, T beta, T* psixT) const{
+        //Reuse Z's buffer because not needed anymore after and elementwise
+        fn_sel_->dphi(0,ns,Z,signs_sel_,Z);
+        {
+            tools::scoped_phase phase(tools::PHASE_ELEMENTWISE, elementwise_bytes(ns, 3), n_sel_*ns);
+            tools::multiply(n_sel_, ns, Z, ld_, RZ, ld_, Z, ld_);
+        }
+        tools::tall_skinny_product(NC_,n_sel_,ns,(T)1,X,ldx,Z,ld_,beta,psixT,frame_of(X));
+    }
+
+    /* Psi = dphi(Z).*RZ and psixT = X'*psi (and variance = (X.^2)'*psi.^2 if not NULL) over a window that fits
+     * in one tile, with dphi(Z) kept in the curvature cache. The conjugate gradient evaluates all its products,
+     * and the variance of the first one, at the same W over the same window : only the first one projects Z
+     * and evaluates dphi, the next ones only project RZ. Returns false, leaving the outputs untouched, without
+     * a cache or for larger windows */
+    bool cached_curvature(int64_t offset, int64_t sample_size, T* variance) const{
+        if(!curvature_cache_.get() || sample_size > tile_)
+            return false;
+        int64_t ldx;
+        stage(offset, sample_size, 0);
+        T const * X = frames(offset, 0, ldx);
+        T* D = curvature_cache_.get();
+        if(offset!=cached_offset_ || sample_size!=cached_size_ || n_sel_!=cached_n_ || !std::equal(W_sel_, W_sel_ + NC_*n_sel_, cached_W_.begin())){
+            backend<T>::gemm(NoTrans,NoTrans,sample_size,n_sel_,NC_,1,X,ldx,W_sel_,NC_,0,D,ld_);
+            fn_sel_->dphi(0,sample_size,D,signs_sel_,D);
+            std::copy(W_sel_, W_sel_ + NC_*n_sel_, cached_W_.begin());
+            cached_offset_ = offset;
+            cached_size_ = sample_size;
+            cached_n_ = n_sel_;
+        }
+        backend<T>::gemm(NoTrans,NoTrans,sample_size,n_sel_,NC_,1,X,ldx,V_sel_,NC_,0,RZ,ld_);
+        {
+            tools::scoped_phase phase(tools::PHASE_ELEMENTWISE, elementwise_bytes(sample_size, 3), n_sel_*sample_size);
+            tools::multiply(n_sel_, sample_size, D, ld_, RZ, ld_, Z, ld_);
+        }
+        tools::tall_skinny_product(NC_,n_sel_,sample_size,(T)1,X,ldx,Z,ld_,(T)0,psixT,frame_of(X));
+        if(variance)
+            second_moment(offset, sample_size, X, ldx, Z, RZ, (T)0, variance);
+        return true;
+    }
+
+    //Y = Y.^2, variance = beta*variance + (X.^2)'*Y. scratch must no longer be needed
+    void second_moment(int64_t t, int64_t ns, T const * X, int64_t ldx, T* Y, T* scratch, T beta, T* variance) const{
+        {
+            tools::scoped_phase phase(tools::PHASE_ELEMENTWISE, elementwise_bytes(ns, 2), n_sel_*ns);
+            tools::square(n_sel_, ns, Y, ld_, Y, ld_);
+        }
+        int64_t ldsq;
+        T const * datasq = squares(t, ns, X, ldx, scratch, ldsq);
+        tools::tall_skinny_product(NC_,n_sel_,ns,(T)1,datasq,ldsq,Y,ld_,beta,variance,datasq_?t:0);
+    }
+
+    uint64_t elementwise_bytes(int64_t sample_size, int64_t n_operands) const
+    { return (uint64_t)n_operands*n_sel_*sample_size*sizeof(T); }
+
+    uint64_t parameter_bytes() const
+    { return (8*NC_*NC_ + 3*NC_)*sizeof(T) + (NC_+1)*sizeof(typename backend<T>::size_t); }
+
+    /* Squared data of the tile [t, t+ns), whose frames are X. When not cached, it is computed into scratch (an
+     * NC*ld_ buffer), which must no longer be needed */
+    T const * squares(int64_t t, int64_t ns, T const * X, int64_t ldx, T* scratch, int64_t & ld) const{
+        if(datasq_){
+            ld = NF_;
+            return datasq_ + t;
+        }
+        tools::scoped_phase phase(tools::PHASE_ELEMENTWISE, elementwise_bytes(ns, 2), NC_*ns);
+        tools::square(NC_, ns, X, ldx, scratch, ld_);
+        ld = ld_;
+        return scratch;
+    }
+
+    tools::whitened_data<T> data_;
+    T * first_signs;
+
+    int64_t NC_;
+    int64_t NF_;
+    int64_t tile_;
+    int64_t ld_;
+    bool pipelined_;
+    bool fused_;
+
+
+    typename backend<T>::size_t *ipiv_;
+
+
+    tools::buffer<T> Z_;
+    tools::buffer<T> RZ_;
+    tools::buffer<T> datasq_buffer_;
+    //Channel-major copy in T of the tiles of the data, unless used in place
+    tools::buffer<T> staging_;
+    //dphi(X*W) over the frames [cached_offset_, cached_offset_+cached_size_) of the data, for the W in cached_W_
+    tools::buffer<T> curvature_cache_;
+    mutable std::vector<T> cached_W_;
+    mutable int64_t cached_offset_;
+    mutable int64_t cached_size_;
+    mutable int64_t cached_n_;
+    //inv(W) in WLU and log|det(W)| given by share_inverse
+    mutable bool shared_inverse_;
+    mutable T shared_logabsdet_;
+
+    //Components of the current evaluation (see select) : their number, columns of W and V, signs and nonlinearity
+    mutable int64_t n_sel_;
+    mutable T const * W_sel_;
+    mutable T const * V_sel_;
+    mutable T * signs_sel_;
+    mutable dist_base<T> * fn_sel_;
+    mutable std::vector<T> W_gathered_;
+    mutable std::vector<T> V_gathered_;
+    mutable std::vector<T> signs_gathered_;
+    //Nonlinearities over subsets of the components, by size
+    mutable std::vector<std::shared_ptr<dist_base<T>>> subsets_;
+
+    active_set const * active_;
+    //mu of the frozen components over the frames [frozen_offset_, frozen_offset_+frozen_size_), for the set frozen_version_
+    mutable std::vector<T> frozen_mu_;
+    mutable int64_t frozen_offset_;
+    mutable int64_t frozen_size_;
+    mutable size_t frozen_version_;
+
+    mutable double gradient_seconds_;
+    mutable double hv_seconds_;
+
+    T* Z ;
+    T* RZ;
+
+    T* phixT;
+    T* psixT;
+
+    T* datasq_;
+
+    T* wmT;
+    T* V;
+    T* HV;
+    T* WinvV;
+    T* W;
+    T* WLU;
+    T* mu;
+    T* mu_tile;
+
+    std::shared_ptr<dist_base<T>> fn_;
+};
+
+template<class T>
+dist_base<T>* make_dist(bool extended, int64_t NC, int64_t ld, accuracy_tier accuracy){
+    if(extended)
+        return new dist<T, extended_infomax>(NC, ld, accuracy);
+    return new dist<T, infomax>(NC, ld, accuracy);
+}
+
+}
+
+#endif
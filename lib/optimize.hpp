@@ -0,0 +1,134 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_OPTIMIZE_HPP_
+#define NEO_ICA_OPTIMIZE_HPP_
+
+#include "lib/adaptive_sampling.hpp"
+#include "lib/log_likelihood.hpp"
+#include "lib/stratified_objective.hpp"
+#include "neo_ica/tools/tracer.h"
+
+#include "umintl/minimize.hpp"
+#include "umintl/stopping_criterion/parameter_change_threshold.hpp"
+
+//Truncated Newton driver of the objective, internal to the library
+
+namespace neo_ica{
+
+//Updates the active set before each direction, whose frozen entries are zeroed with those of the gradient
+template<class BackendType>
+struct profiled_truncated_newton: public umintl::truncated_newton<BackendType>{
+    profiled_truncated_newton(umintl::tag::truncated_newton::stopping_criterion stop, active_set * active, unsigned int verbose) : umintl::truncated_newton<BackendType>(stop), active_(active), verbose_(verbose){ }
+    void operator()(umintl::optimization_context<BackendType> & c){
+        tools::scoped_phase phase(tools::PHASE_CONJUGATE_GRADIENT);
+        if(active_){
+            active_->update(c.g(), verbose_);
+            active_->mask(c.g());
+            active_->mask(c.p());
+        }
+        umintl::truncated_newton<BackendType>::operator()(c);
+        if(active_)
+            active_->mask(c.p());
+    }
+private:
+    active_set * active_;
+    unsigned int verbose_;
+};
+
+template<class BackendType>
+struct profiled_line_search: public umintl::strong_wolfe_powell<BackendType>{
+    profiled_line_search(bool early_exit = false) : umintl::strong_wolfe_powell<BackendType>(40, early_exit){ }
+    void operator()(umintl::line_search_result<BackendType> & res, umintl::direction<BackendType> * direction, umintl::optimization_context<BackendType> & c){
+        tools::scoped_phase phase(tools::PHASE_LINE_SEARCH);
+        umintl::strong_wolfe_powell<BackendType>::operator()(res, direction, c);
+    }
+};
+
+template<class BackendType>
+struct trace_monitor: public umintl::monitor<BackendType>{
+    void begin_iteration(umintl::optimization_context<BackendType> &){
+        begin_ = tools::tracer::get().now();
+    }
+    void end_iteration(umintl::optimization_context<BackendType> & c){
+        tools::tracer & tracer = tools::tracer::get();
+        tracer.record(tools::current_thread(), "iteration", begin_, tracer.now(), "iteration", c.iter());
+    }
+private:
+    int64_t begin_;
+};
+
+//Sample size and offsets of the dynamically sampled model, carried from one precision to the next
+struct sampling_state{
+    sampling_state() : resume(false), sample_size(0), offset(0), hv_offset(0), rho(0), theta(0){ }
+    bool resume;
+    size_t sample_size;
+    size_t offset;
+    size_t hv_offset;
+    //As tuned by the adaptive sampling
+    double rho;
+    double theta;
+};
+
+//Truncated Newton from X down to a parameter change of tol, on the strata of a coreset if weighted is given
+template<class T>
+umintl::optimization_result::termination_cause_type optimize(log_likelihood<T> & objective, T * X, int64_t NC, int64_t NF, options const & opt, double tol, sampling_state & sampling, stratified_objective<T> * weighted = NULL){
+    typedef typename umintl_backend<T>::type BackendType;
+    umintl::minimizer<BackendType> minimizer;
+    minimizer.hessian_vector_product_computation = umintl::PROVIDED;
+    umintl::dynamically_sampled<BackendType> * model;
+    if(opt.adaptive_sampling)
+        model = new adaptive_sampling<T>(objective, sampling.resume?sampling.rho:opt.rho, opt.fbatch, NF, sampling.resume?sampling.theta:opt.theta, opt.verbose);
+    else
+        model = new umintl::dynamically_sampled<BackendType>(opt.rho,opt.fbatch,NF,opt.theta);
+    if(sampling.resume)
+        model->resume(sampling.sample_size, sampling.offset, sampling.hv_offset);
+    minimizer.model = model;
+
+    active_set active(NC, opt.freeze_tol, opt.freeze_period);
+    active_set * freezing = (opt.freeze_tol > 0)?&active:NULL;
+    objective.components(freezing);
+    minimizer.direction = new profiled_truncated_newton<BackendType>(umintl::tag::truncated_newton::STOP_HV_VARIANCE, freezing, opt.verbose);
+    minimizer.line_search = new profiled_line_search<BackendType>(opt.early_exit);
+    if(tools::tracer::get().enabled())
+        minimizer.monitor = new trace_monitor<BackendType>();
+    minimizer.verbose = opt.verbose;
+    minimizer.iter = opt.iter;
+    minimizer.stopping_criterion = new umintl::parameter_change_threshold<BackendType>(tol);
+    umintl::optimization_result result;
+    stratified_objective<T> strata(objective, NC, NF);
+    for(;;){
+        //The scores depend on the signs : the strata are drawn again after a change
+        if(weighted)
+            result = minimizer(X,*weighted,X,NC*NC);
+        else if(opt.importance_sampling){
+            strata.stratify(X, opt.verbose);
+            result = minimizer(X,strata,X,NC*NC);
+        }
+        else
+            result = minimizer(X,objective,X,NC*NC);
+        if(!opt.extended || !objective.resigns(X))
+            break;
+        //New signs : the frozen components are checked again
+        active.thaw();
+    }
+    objective.components(NULL);
+
+    sampling.resume = true;
+    sampling.sample_size = model->sample_size();
+    sampling.offset = model->offset();
+    sampling.hv_offset = model->hv_offset();
+    sampling.rho = model->hessian_ratio();
+    sampling.theta = model->theta();
+    return result.termination_cause;
+}
+
+}
+
+#endif
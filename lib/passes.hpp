@@ -0,0 +1,205 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_PASSES_HPP_
+#define NEO_ICA_PASSES_HPP_
+
+#include "lib/optimize.hpp"
+#include "neo_ica/tools/layout.hpp"
+#include "neo_ica/tools/memory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+//Formats of the whitened data and the passes before the full optimization, internal to the library
+
+namespace neo_ica{
+
+//Layout and storage of the whitened data
+struct data_format{
+    bool fused;
+    bool blocked;
+    storage_type storage;
+};
+
+//Frame-blocked or 16-bit data only for the fused kernels
+template<class T>
+data_format choose_format(int64_t NC, options const & opt, bool verbose){
+    data_format format;
+    format.fused = opt.fused_kernels && has_fused_kernels<T>(NC);
+    format.blocked = opt.frame_blocked && format.fused;
+    if(opt.frame_blocked && !format.blocked && verbose)
+        std::cout << "Frame-blocked data needs the fused kernels, using channel-major data" << std::endl;
+    format.storage = (format.fused && tools::storage_supported(opt.storage))?opt.storage:STORAGE_NATIVE;
+    if(format.storage!=opt.storage && verbose)
+        std::cout << "Storage " << tools::storage_name(opt.storage) << " needs the fused kernels and the hardware to convert it, using native storage" << std::endl;
+    return format;
+}
+
+//Whitened data of the given format, in native_buffer or compact_buffer
+template<class T>
+tools::whitened_data<T> allocate_whitened(int64_t NC, int64_t NF, data_format const & format, tools::buffer<T> & native_buffer, tools::buffer<uint16_t> & compact_buffer){
+    int64_t rows = format.blocked?1:NC, row_frames = format.blocked?NC*tools::blocked_frames(NF):NF;
+    void * data;
+    if(format.storage==STORAGE_NATIVE){
+        native_buffer.allocate(rows, row_frames, tools::MEMORY_DATA);
+        data = native_buffer.get();
+    }
+    else{
+        compact_buffer.allocate(rows, row_frames, tools::MEMORY_DATA);
+        data = compact_buffer.get();
+    }
+    return tools::whitened_data<T>(data, NC, NF, format.blocked, format.storage);
+}
+
+//Nothing to escalate from in single precision
+template<class T>
+void coarse_pass(tools::whitened_data<T> const &, T *, options const &, sampling_state &)
+{ }
+
+//Coreset of about fraction*NF frames, strata of the sensitivity 1/NF + |x|^2/sum(|x|^2) keeping frames in proportion
+//to their sensitivity, evenly spaced in time : indices of the frames, bounds of the strata in indices and share of the frames of each
+template<class T>
+void sensitivity_sample(tools::whitened_data<T> const & data, double fraction, std::vector<int64_t> & indices, std::vector<int64_t> & begin, std::vector<double> & weights){
+    int64_t NC = data.NC, NF = data.NF;
+    std::vector<double> sensitivity(NF, 0), sorted;
+    {
+        std::vector<T> row(NF);
+        for(int64_t c = 0 ; c < NC ; ++c){
+            data.read(c, 0, NF, row.data());
+            for(int64_t f = 0 ; f < NF ; ++f)
+                sensitivity[f] += (double)row[f]*row[f];
+        }
+    }
+    double total = 0;
+    for(int64_t f = 0 ; f < NF ; ++f)
+        total += sensitivity[f];
+    for(int64_t f = 0 ; f < NF ; ++f)
+        sensitivity[f] = 0.5/NF + ((total > 0)?0.5*sensitivity[f]/total:0.5/NF);
+
+    sorted = sensitivity;
+    std::vector<double> bounds(importance_strata - 1);
+    for(int64_t s = 0 ; s < importance_strata - 1 ; ++s){
+        int64_t rank = std::min<int64_t>(NF - 1, (int64_t)(importance_quantiles[s]*NF));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        bounds[s] = sorted[rank];
+    }
+    std::vector<int64_t> stratum(NF), count(importance_strata, 0);
+    std::vector<double> mass(importance_strata, 0);
+    for(int64_t f = 0 ; f < NF ; ++f){
+        stratum[f] = std::upper_bound(bounds.begin(), bounds.end(), sensitivity[f]) - bounds.begin();
+        ++count[stratum[f]];
+        mass[stratum[f]] += sensitivity[f];
+    }
+
+    int64_t M = std::max<int64_t>(1, (int64_t)(fraction*NF));
+    std::vector<int64_t> kept(importance_strata);
+    begin.assign(importance_strata + 1, 0);
+    weights.assign(importance_strata, 0);
+    for(int64_t s = 0 ; s < importance_strata ; ++s){
+        kept[s] = std::min(count[s], std::max(std::min(count[s], importance_min_frames), (int64_t)std::ceil(mass[s]*M)));
+        begin[s + 1] = begin[s] + kept[s];
+        weights[s] = (double)count[s]/NF;
+    }
+    indices.resize(begin.back());
+    //Frame r of stratum s is kept when floor(r*kept/count) steps
+    std::vector<int64_t> next(begin.begin(), begin.end() - 1), rank(importance_strata, 0);
+    for(int64_t f = 0 ; f < NF ; ++f){
+        int64_t s = stratum[f], r = rank[s]++;
+        if((r + 1)*kept[s]/count[s] > r*kept[s]/count[s])
+            indices[next[s]++] = f;
+    }
+}
+
+//Optimizes X on a weighted coreset copied next to the data, unless it does not fit in max_memory. Returns whether it ran
+template<class T>
+bool coreset_pass(tools::whitened_data<T> const & data, T * X, options const & opt){
+    int64_t NC = data.NC, NF = data.NF;
+    std::vector<int64_t> indices, begin;
+    std::vector<double> weights;
+    {
+        tools::scoped_phase phase(tools::PHASE_STRATIFY);
+        sensitivity_sample(data, opt.coreset_fraction, indices, begin, weights);
+    }
+    int64_t M = indices.size();
+    data_format format = {false, data.blocked, data.storage};
+    tools::memory_plan plan;
+    try{
+        if(opt.max_memory > 0 && opt.max_memory <= data.bytes())
+            throw neo_ica::exception("max_memory is used up by the data");
+        plan = tools::plan_memory(NC, M, sizeof(T), opt.max_memory?opt.max_memory - data.bytes():0, format.blocked, tools::storage_size(format.storage));
+    }
+    catch(neo_ica::exception const & e){
+        if(opt.verbose >= 1)
+            std::cout << "Coreset skipped : " << e.what() << std::endl;
+        return false;
+    }
+
+    tools::buffer<T> native_buffer;
+    tools::buffer<uint16_t> compact_buffer;
+    tools::whitened_data<T> coreset = allocate_whitened<T>(NC, M, format, native_buffer, compact_buffer);
+    {
+        tools::scoped_phase phase(tools::PHASE_STRATIFY, data.bytes() + coreset.bytes());
+        std::vector<T> row(NF), kept(M);
+        for(int64_t c = 0 ; c < NC ; ++c){
+            data.read(c, 0, NF, row.data());
+            for(int64_t i = 0 ; i < M ; ++i)
+                kept[i] = row[indices[i]];
+            coreset.write(c, 0, M, kept.data());
+        }
+    }
+    if(opt.verbose >= 1)
+        std::cout << "Coreset of " << M << " frames" << std::endl;
+
+    log_likelihood<T> objective(coreset, make_dist<T>(opt.extended, NC, plan.ld, opt.accuracy), plan, opt.pipeline, opt.fused_kernels);
+    stratified_objective<T> strata(objective, NC, M);
+    strata.assign(begin, weights);
+    sampling_state sampling;
+    optimize(objective, X, NC, M, opt, opt.tol, sampling, &strata);
+    return true;
+}
+
+//Optimizes X up to escalation*tol on a single precision copy of the data, unless it does not fit in max_memory
+inline void coarse_pass(tools::whitened_data<double> const & data, double * X, options const & opt, sampling_state & sampling){
+    int64_t NC = data.NC, NF = data.NF;
+    data_format format = choose_format<float>(NC, opt, opt.verbose >= 1);
+    tools::memory_plan plan;
+    try{
+        if(opt.max_memory > 0 && opt.max_memory <= data.bytes())
+            throw neo_ica::exception("max_memory is used up by the double precision data");
+        plan = tools::plan_memory(NC, NF, sizeof(float), opt.max_memory?opt.max_memory - data.bytes():0, format.blocked, tools::storage_size(format.storage));
+    }
+    catch(neo_ica::exception const & e){
+        if(opt.verbose >= 1)
+            std::cout << "Mixed precision skipped : " << e.what() << std::endl;
+        return;
+    }
+
+    tools::buffer<float> native_buffer;
+    tools::buffer<uint16_t> compact_buffer;
+    tools::whitened_data<float> coarse = allocate_whitened<float>(NC, NF, format, native_buffer, compact_buffer);
+    {
+        tools::scoped_phase phase(tools::PHASE_WHITEN, data.bytes() + coarse.bytes());
+        tools::convert(data, coarse);
+    }
+
+    std::vector<float> W(X, X + NC*NC);
+    log_likelihood<float> objective(coarse, make_dist<float>(opt.extended, NC, plan.ld, opt.accuracy), plan, opt.pipeline, opt.fused_kernels);
+    umintl::optimization_result::termination_cause_type cause = optimize(objective, W.data(), NC, NF, opt, opt.escalation*opt.tol, sampling);
+    std::copy(W.begin(), W.end(), X);
+    if(opt.verbose >= 1)
+        std::cout << "Escalating to double precision"
+                  << ((cause==umintl::optimization_result::LINE_SEARCH_FAILED)?" after a failed line search":"") << std::endl;
+}
+
+}
+
+#endif
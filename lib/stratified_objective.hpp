@@ -0,0 +1,241 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_STRATIFIED_OBJECTIVE_HPP_
+#define NEO_ICA_STRATIFIED_OBJECTIVE_HPP_
+
+#include "lib/log_likelihood.hpp"
+
+#include "umintl/forwards.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+//Importance sampling of the frames, internal to the library
+
+namespace neo_ica{
+
+//Importance sampling : upper quantiles of the scores that bound the strata, and smallest window of a stratum
+static const double importance_quantiles[] = {0.5, 0.75, 0.9, 0.97, 0.99};
+static const int64_t importance_strata = sizeof(importance_quantiles)/sizeof(importance_quantiles[0]) + 1;
+static const int64_t importance_min_frames = 16;
+
+//Objective over strata of the frames by score |phi(z)|*|x| : a sample takes a Neyman-allocated window of each
+//stratum, weighted by its share N_s/N of the frames
+template<class T>
+struct stratified_objective{
+    typedef T * VectorType;
+
+    stratified_objective(log_likelihood<T> & objective, int64_t NC, int64_t NF) : objective_(objective), NC_(NC), NF_(NF), begin_(importance_strata + 1, 0), weights_(importance_strata, 0), allocation_(importance_strata, 0){
+        begin_.back() = NF;
+    }
+
+    //Strata of the caller, the frames [begin[s], begin[s+1]) standing for a share weights[s] of a larger population
+    void assign(std::vector<int64_t> const & begin, std::vector<double> const & weights){
+        begin_ = begin;
+        weights_ = weights;
+        allocation_.resize(weights.size());
+        for(size_t s = 0 ; s < weights.size() ; ++s)
+            allocation_[s] = (double)(begin[s + 1] - begin[s])/NF_;
+    }
+
+    //Scores the frames under the parameters x, reorders the data by strata and allocates the windows
+    void stratify(T const * x, unsigned int verbose){
+        tools::scoped_phase phase(tools::PHASE_STRATIFY);
+        tools::buffer<T> scores_buffer(NF_, tools::MEMORY_SHUFFLE), sorted_buffer(NF_, tools::MEMORY_SHUFFLE);
+        tools::buffer<int64_t> perm_buffer(NF_, tools::MEMORY_SHUFFLE);
+        T * scores = scores_buffer.get(), * sorted = sorted_buffer.get();
+        int64_t * perm = perm_buffer.get();
+        objective_.frame_scores(x, scores);
+
+        std::copy(scores, scores + NF_, sorted);
+        std::vector<T> bounds(importance_strata - 1);
+        for(int64_t s = 0 ; s < importance_strata - 1 ; ++s){
+            int64_t rank = std::min<int64_t>(NF_ - 1, (int64_t)(importance_quantiles[s]*NF_));
+            std::nth_element(sorted, sorted + rank, sorted + NF_);
+            bounds[s] = sorted[rank];
+        }
+        std::vector<int64_t> count(importance_strata, 0);
+        std::vector<double> squares(importance_strata, 0);
+        for(int64_t f = 0 ; f < NF_ ; ++f){
+            int64_t s = std::upper_bound(bounds.begin(), bounds.end(), scores[f]) - bounds.begin();
+            ++count[s];
+            squares[s] += (double)scores[f]*scores[f];
+        }
+        double total = 0;
+        for(int64_t s = 0 ; s < importance_strata ; ++s){
+            begin_[s + 1] = begin_[s] + count[s];
+            weights_[s] = (double)count[s]/NF_;
+            allocation_[s] = std::sqrt(squares[s]*count[s]);
+            total += allocation_[s];
+        }
+        for(int64_t s = 0 ; s < importance_strata ; ++s)
+            allocation_[s] = (total > 0)?allocation_[s]/total:(double)count[s]/NF_;
+
+        std::vector<int64_t> next(begin_.begin(), begin_.end() - 1);
+        for(int64_t f = 0 ; f < NF_ ; ++f)
+            perm[next[std::upper_bound(bounds.begin(), bounds.end(), scores[f]) - bounds.begin()]++] = f;
+        objective_.permute(perm);
+
+        if(verbose >= 1){
+            std::cout << "Importance sampling : strata of";
+            for(int64_t s = 0 ; s < importance_strata ; ++s)
+                std::cout << " " << count[s] << " (" << (int)(100*allocation_[s] + 0.5) << "%)";
+            std::cout << " frames" << std::endl;
+        }
+    }
+
+    void operator()(VectorType const & x, T & value, VectorType & grad, umintl::value_gradient tag){
+        if(tag.model==umintl::DETERMINISTIC)
+            return objective_(x, value, grad, tag);
+        std::vector<window> w = windows(tag.sample_size, tag.offset);
+        shared_inverse inverse(objective_, x);
+        buffer_.resize(NC_*NC_);
+        T * part = buffer_.data();
+        value = 0;
+        std::fill(grad, grad + NC_*NC_, 0);
+        for(size_t s = 0 ; s < w.size() ; ++s){
+            T v;
+            objective_(x, v, part, umintl::value_gradient(umintl::STOCHASTIC, w[s].size, w[s].offset));
+            value += (T)w[s].weight*v;
+            for(int64_t i = 0 ; i < NC_*NC_ ; ++i)
+                grad[i] += (T)w[s].weight*part[i];
+        }
+    }
+
+    //Gives up once the strata evaluated exceed the bound, those left counting for at least -log|det(W)| each
+    bool operator()(VectorType const & x, T & value, VectorType & grad, umintl::bounded_value_gradient tag){
+        if(tag.model==umintl::DETERMINISTIC)
+            return objective_(x, value, grad, tag);
+        std::vector<window> w = windows(tag.sample_size, tag.offset);
+        shared_inverse inverse(objective_, x);
+        buffer_.resize(NC_*NC_);
+        T * part = buffer_.data();
+        value = 0;
+        std::fill(grad, grad + NC_*NC_, 0);
+        //Share of the population evaluated, and frames read
+        double done = 0;
+        size_t read = 0;
+        for(size_t s = 0 ; s < w.size() ; ++s){
+            //The bound of the whole sample, for the value of this stratum
+            double left = 1 - done - w[s].weight;
+            double bound = (tag.bound - value + left*inverse.logabsdet)/w[s].weight;
+            size_t frames = w[s].size;
+            T v;
+            bool complete = objective_(x, v, part, umintl::bounded_value_gradient(umintl::STOCHASTIC, w[s].size, w[s].offset, bound, &frames));
+            value += (T)w[s].weight*v;
+            done += w[s].weight;
+            read += frames;
+            if(!complete || (s + 1 < w.size() && value - left*inverse.logabsdet > tag.bound)){
+                value = (T)(value/done);
+                if(tag.read)
+                    *tag.read = read;
+                return false;
+            }
+            for(int64_t i = 0 ; i < NC_*NC_ ; ++i)
+                grad[i] += (T)w[s].weight*part[i];
+        }
+        return true;
+    }
+
+    void operator()(VectorType const & x, VectorType const & v, VectorType & Hv, umintl::hessian_vector_product tag){
+        if(tag.model==umintl::DETERMINISTIC)
+            return objective_(x, v, Hv, tag);
+        std::vector<window> w = windows(tag.sample_size, tag.offset);
+        shared_inverse inverse(objective_, x);
+        buffer_.resize(NC_*NC_);
+        T * part = buffer_.data();
+        std::fill(Hv, Hv + NC_*NC_, 0);
+        for(size_t s = 0 ; s < w.size() ; ++s){
+            objective_(x, v, part, umintl::hessian_vector_product(umintl::STOCHASTIC, w[s].size, w[s].offset));
+            for(int64_t i = 0 ; i < NC_*NC_ ; ++i)
+                Hv[i] += (T)w[s].weight*part[i];
+        }
+    }
+
+    void operator()(VectorType const & x, VectorType & variance, umintl::gradient_variance tag){
+        if(tag.model==umintl::DETERMINISTIC)
+            return objective_(x, variance, tag);
+        std::vector<window> w = windows(tag.sample_size, tag.offset);
+        buffer_.resize(NC_*NC_);
+        T * part = buffer_.data();
+        std::fill(variance, variance + NC_*NC_, 0);
+        for(size_t s = 0 ; s < w.size() ; ++s){
+            objective_(x, part, umintl::gradient_variance(umintl::STOCHASTIC, w[s].size, w[s].offset));
+            combine_variance(w[s], tag.sample_size, part, variance);
+        }
+    }
+
+    void operator()(VectorType const & x, VectorType const & v, VectorType & variance, umintl::hv_product_variance tag){
+        if(tag.model==umintl::DETERMINISTIC)
+            return objective_(x, v, variance, tag);
+        std::vector<window> w = windows(tag.sample_size, tag.offset);
+        buffer_.resize(NC_*NC_);
+        T * part = buffer_.data();
+        std::fill(variance, variance + NC_*NC_, 0);
+        for(size_t s = 0 ; s < w.size() ; ++s){
+            objective_(x, v, part, umintl::hv_product_variance(umintl::STOCHASTIC, w[s].size, w[s].offset));
+            combine_variance(w[s], tag.sample_size, part, variance);
+        }
+    }
+
+private:
+    struct window{
+        int64_t offset;
+        int64_t size;
+        double weight;
+    };
+
+    //W factored once for all the windows of an evaluation
+    struct shared_inverse{
+        shared_inverse(log_likelihood<T> const & objective, T const * x) : objective_(objective), logabsdet(objective.share_inverse(x)){ }
+        ~shared_inverse(){ objective_.release_inverse(); }
+        log_likelihood<T> const & objective_;
+        T logabsdet;
+    };
+
+    //Windows of the strata for a sample of n frames at the given offset
+    std::vector<window> windows(int64_t n, int64_t offset) const{
+        std::vector<window> res;
+        for(size_t s = 0 ; s < weights_.size() ; ++s){
+            int64_t frames = begin_[s + 1] - begin_[s];
+            if(frames==0)
+                continue;
+            window w;
+            w.size = (n >= NF_)?frames:std::min(frames, std::max(importance_min_frames, (int64_t)std::ceil(allocation_[s]*n)));
+            w.offset = begin_[s] + (int64_t)((double)offset/NF_*frames)%(frames - w.size + 1);
+            w.weight = weights_[s];
+            res.push_back(w);
+        }
+        return res;
+    }
+
+    //variance += n*weight^2/size*part, the per-frame variance of a window scaled to that of the sample
+    void combine_variance(window const & w, int64_t n, T const * part, T * variance) const{
+        T scale = (T)(n*w.weight*w.weight/w.size);
+        for(int64_t i = 0 ; i < NC_*NC_ ; ++i)
+            variance[i] += scale*part[i];
+    }
+
+    log_likelihood<T> & objective_;
+    int64_t NC_;
+    int64_t NF_;
+    //Strata s are the frames [begin_[s], begin_[s+1])
+    std::vector<int64_t> begin_;
+    //Share of the population of each stratum, and of a sample
+    std::vector<double> weights_;
+    std::vector<double> allocation_;
+    std::vector<T> buffer_;
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "neo_ica/tools/arena.h"
+#include "neo_ica/tools/mex.hpp"
+#include "neo_ica/tools/parallel.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+namespace{
+
+    //Transparent huge pages are only used for regions aligned on (and spanning) whole huge pages
+    static const size_t huge_page_size = 2*1024*1024;
+
+    size_t page_size(){
+#ifdef __linux__
+        long size = sysconf(_SC_PAGESIZE);
+        return (size > 0)?(size_t)size:4096;
+#else
+        return 4096;
+#endif
+    }
+
+}
+
+arena & arena::get(){
+    static arena instance;
+    return instance;
+}
+
+void* arena::allocate(size_t bytes, memory_category category, size_t row_bytes){
+    if(bytes==0)
+        bytes = 1;
+    bool huge = huge_pages_ && bytes >= huge_page_size;
+    size_t alignment = huge?huge_page_size:arena_alignment;
+    void* ptr = NULL;
+    if(posix_memalign(&ptr, alignment, bytes) != 0)
+        throw neo_ica::exception("Out of memory");
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    //Advisory only : failures (THP disabled) are harmless
+    if(huge)
+        madvise(ptr, round_to_previous_multiple(bytes, huge_page_size), MADV_HUGEPAGE);
+#endif
+
+    //Touches one byte per page from all the threads, so that the faults are taken here rather than in the
+    //first kernels. A page belongs to the thread whose frame range contains its first byte
+    if(prefault_){
+        char* base = static_cast<char*>(ptr);
+        uintptr_t page = page_size();
+        if(row_bytes==0 || row_bytes > bytes)
+            row_bytes = bytes;
+        int64_t nrows = bytes/row_bytes;
+        base[0] = 0;
+        parallel_for(0, row_bytes, arena_alignment, [&](int64_t begin, int64_t end){
+            for(int64_t r = 0 ; r < nrows ; ++r){
+                uintptr_t first = reinterpret_cast<uintptr_t>(base + r*row_bytes + begin);
+                uintptr_t last = reinterpret_cast<uintptr_t>(base + r*row_bytes + end);
+                for(uintptr_t p = round_to_next_multiple(first, page) ; p < last ; p += page)
+                    *reinterpret_cast<char*>(p) = 0;
+            }
+        });
+    }
+
+    memory_tracker::get().allocate(category, bytes);
+    return ptr;
+}
+
+void arena::release(void* ptr, size_t bytes, memory_category category){
+    free(ptr);
+    memory_tracker::get().release(category, (bytes==0)?1:bytes);
+}
+
+}
+}
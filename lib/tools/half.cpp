@@ -0,0 +1,155 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cstring>
+
+#include "neo_ica/backend/cpu_x86.h"
+#include "neo_ica/tools/half.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+namespace
+{
+
+#if defined(__GNUC__)
+#define NEO_ICA_F16C __attribute__((target("f16c")))
+#else
+#define NEO_ICA_F16C
+#endif
+
+    NEO_ICA_F16C void half_to_float(uint16_t const * in, int64_t n, float * out){
+        int64_t i = 0;
+        for(; i + 4 <= n ; i += 4)
+            _mm_storeu_ps(out + i, _mm_cvtph_ps(_mm_loadl_epi64((__m128i const *)(in + i))));
+        if(i < n){
+            uint16_t tail[4] = {0, 0, 0, 0};
+            float res[4];
+            std::copy(in + i, in + n, tail);
+            _mm_storeu_ps(res, _mm_cvtph_ps(_mm_loadl_epi64((__m128i const *)tail)));
+            std::copy(res, res + (n - i), out + i);
+        }
+    }
+
+    NEO_ICA_F16C void float_to_half(float const * in, int64_t n, uint16_t * out){
+        int64_t i = 0;
+        for(; i + 4 <= n ; i += 4)
+            _mm_storel_epi64((__m128i *)(out + i), _mm_cvtps_ph(_mm_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+        if(i < n){
+            float tail[4] = {0, 0, 0, 0};
+            uint16_t res[4];
+            std::copy(in + i, in + n, tail);
+            _mm_storel_epi64((__m128i *)res, _mm_cvtps_ph(_mm_loadu_ps(tail), _MM_FROUND_TO_NEAREST_INT));
+            std::copy(res, res + (n - i), out + i);
+        }
+    }
+
+#undef NEO_ICA_F16C
+
+    //The bits of a bfloat16 are the upper half of the float
+    void bfloat16_to_float(uint16_t const * in, int64_t n, float * out){
+        __m128i zero = _mm_setzero_si128();
+        int64_t i = 0;
+        for(; i + 8 <= n ; i += 8){
+            __m128i x = _mm_loadu_si128((__m128i const *)(in + i));
+            _mm_storeu_ps(out + i, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, x)));
+            _mm_storeu_ps(out + i + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, x)));
+        }
+        for(; i < n ; ++i){
+            uint32_t bits = (uint32_t)in[i] << 16;
+            std::memcpy(out + i, &bits, sizeof(bits));
+        }
+    }
+
+    //Rounds to nearest even : adds 0x7FFF plus the parity of the kept part before truncating
+    void float_to_bfloat16(float const * in, int64_t n, uint16_t * out){
+        __m128i bias = _mm_set1_epi32(0x7FFF);
+        __m128i one = _mm_set1_epi32(1);
+        int64_t i = 0;
+        for(; i + 8 <= n ; i += 8){
+            __m128i lo = _mm_castps_si128(_mm_loadu_ps(in + i));
+            __m128i hi = _mm_castps_si128(_mm_loadu_ps(in + i + 4));
+            lo = _mm_srli_epi32(_mm_add_epi32(lo, _mm_add_epi32(bias, _mm_and_si128(_mm_srli_epi32(lo, 16), one))), 16);
+            hi = _mm_srli_epi32(_mm_add_epi32(hi, _mm_add_epi32(bias, _mm_and_si128(_mm_srli_epi32(hi, 16), one))), 16);
+            _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi32(lo, hi));
+        }
+        for(; i < n ; ++i){
+            uint32_t bits;
+            std::memcpy(&bits, in + i, sizeof(bits));
+            out[i] = (uint16_t)((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+        }
+    }
+
+    //Chunk of the conversions of double precision data through single precision
+    static const int64_t conversion_chunk = 256;
+
+}
+
+bool storage_supported(storage_type storage){
+    switch(storage){
+        case STORAGE_FP16: return cpu.HW_F16C;
+        default: return true;
+    }
+}
+
+size_t storage_size(storage_type storage){
+    switch(storage){
+        case STORAGE_FP16: return 2;
+        case STORAGE_BF16: return 2;
+        default: return 0;
+    }
+}
+
+const char* storage_name(storage_type storage){
+    switch(storage){
+        case STORAGE_NATIVE: return "native";
+        case STORAGE_FP16: return "fp16";
+        case STORAGE_BF16: return "bf16";
+        default: return "unknown";
+    }
+}
+
+void widen(storage_type storage, uint16_t const * in, int64_t n, float * out){
+    if(storage==STORAGE_FP16)
+        half_to_float(in, n, out);
+    else
+        bfloat16_to_float(in, n, out);
+}
+
+void narrow(storage_type storage, float const * in, int64_t n, uint16_t * out){
+    if(storage==STORAGE_FP16)
+        float_to_half(in, n, out);
+    else
+        float_to_bfloat16(in, n, out);
+}
+
+void widen(storage_type storage, uint16_t const * in, int64_t n, double * out){
+    float buffer[conversion_chunk];
+    for(int64_t i = 0 ; i < n ; i += conversion_chunk){
+        int64_t m = std::min(conversion_chunk, n - i);
+        widen(storage, in + i, m, buffer);
+        std::copy(buffer, buffer + m, out + i);
+    }
+}
+
+void narrow(storage_type storage, double const * in, int64_t n, uint16_t * out){
+    float buffer[conversion_chunk];
+    for(int64_t i = 0 ; i < n ; i += conversion_chunk){
+        int64_t m = std::min(conversion_chunk, n - i);
+        std::copy(in + i, in + i + m, buffer);
+        narrow(storage, buffer, m, out + i);
+    }
+}
+
+}
+}
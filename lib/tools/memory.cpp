@@ -0,0 +1,140 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "neo_ica/tools/arena.h"
+#include "neo_ica/tools/layout.hpp"
+#include "neo_ica/tools/memory.h"
+#include "neo_ica/tools/mex.hpp"
+#include "neo_ica/tools/round.hpp"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+const char* memory_category_name(memory_category category){
+    switch(category){
+        case MEMORY_DATA: return "data";
+        case MEMORY_OBJECTIVE: return "objective";
+        case MEMORY_SHUFFLE: return "shuffle";
+        case MEMORY_PARAMETERS: return "parameters";
+        default: return "unknown";
+    }
+}
+
+memory_tracker & memory_tracker::get(){
+    static memory_tracker instance;
+    return instance;
+}
+
+void memory_tracker::reset(){
+    for(int i = 0 ; i < N_MEMORY_CATEGORIES ; ++i)
+        current_[i] = peak_[i] = 0;
+    current_total_ = peak_total_ = 0;
+}
+
+void memory_tracker::allocate(memory_category category, uint64_t bytes){
+    current_[category] += bytes;
+    current_total_ += bytes;
+    peak_[category] = std::max(peak_[category], current_[category]);
+    peak_total_ = std::max(peak_total_, current_total_);
+}
+
+void memory_tracker::release(memory_category category, uint64_t bytes){
+    current_[category] -= std::min(bytes, current_[category]);
+    current_total_ -= std::min(bytes, current_total_);
+}
+
+void memory_tracker::print(std::ostream & os) const{
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "Peak memory: " << peak_total_/1048576. << "MB (";
+    for(int i = 0 ; i < N_MEMORY_CATEGORIES ; ++i)
+        os << ((i>0)?", ":"") << memory_category_name((memory_category)i) << "=" << peak_[i]/1048576. << "MB";
+    os << ")" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void memory_tracker::to_json(std::ostream & os) const{
+    os << "{\"peak_bytes\": " << peak_total_ << ", \"peak_bytes_per_category\": {";
+    for(int i = 0 ; i < N_MEMORY_CATEGORIES ; ++i)
+        os << ((i>0)?", ":"") << "\"" << memory_category_name((memory_category)i) << "\": " << peak_[i];
+    os << "}}";
+}
+
+namespace{
+
+    //Smallest tile worth running the GEMMs on
+    static const int64_t min_tile = 256;
+
+    std::string megabytes(uint64_t bytes){
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(1) << bytes/1048576. << "MB";
+        return oss.str();
+    }
+
+}
+
+memory_plan plan_memory(int64_t NC, int64_t NF, size_t scalar_size, uint64_t max_memory, bool frame_blocked, size_t storage_size){
+    //Frame-blocked or 16-bit data is shuffled while whitened, without a scratch row, and its tiles are unpacked
+    //into a third tile buffer
+    bool staged = frame_blocked || storage_size > 0;
+    uint64_t data = (uint64_t)NC*(frame_blocked?blocked_frames(NF):NF)*(storage_size?storage_size:scalar_size);
+    uint64_t shuffle = (uint64_t)NF*(sizeof(size_t) + (staged?0:scalar_size));
+    uint64_t tile_buffers = staged?3:2;
+    //NC*NC matrices of the objective and vectors of the optimizer
+    uint64_t parameters = 24*(uint64_t)NC*NC*scalar_size;
+    uint64_t row = (uint64_t)NC*scalar_size;
+
+    //Rows of the tile buffers are padded to keep every channel aligned
+    unsigned int alignment = arena_alignment/scalar_size;
+
+    memory_plan plan;
+
+    //Unlimited, or enough room for the whole data : Z, RZ, the cached squares and the cached curvature over all
+    //the frames, or all but the latter
+    plan.tile = NF;
+    plan.ld = round_to_next_multiple<int64_t>(NF, alignment);
+    plan.cache_squares = true;
+    plan.cache_curvature = true;
+    plan.peak = data + std::max(shuffle, ((tile_buffers + 1)*plan.ld + NF)*row) + parameters;
+    if(max_memory==0 || plan.peak <= max_memory)
+        return plan;
+    plan.cache_curvature = false;
+    plan.peak = data + std::max(shuffle, (tile_buffers*plan.ld + NF)*row) + parameters;
+    if(plan.peak <= max_memory)
+        return plan;
+
+    //Otherwise, Z and RZ (and the unpacked data) over tiles, the squares being recomputed into RZ once it is no longer needed
+    plan.cache_squares = false;
+    uint64_t fixed = data + parameters;
+    int64_t tile = 0;
+    if(max_memory > fixed + shuffle)
+        tile = std::min<int64_t>(NF, (max_memory - fixed)/(tile_buffers*row));
+    tile = round_to_previous_multiple<int64_t>(tile, alignment);
+    if(tile < std::min(min_tile, NF)){
+        uint64_t required = fixed + std::max(shuffle, tile_buffers*std::min(min_tile, NF)*row);
+        throw neo_ica::exception("max_memory (" + megabytes(max_memory) + ") is below the " + megabytes(required)
+                                 + " required (whitened data: " + megabytes(data) + ", shuffle: " + megabytes(shuffle)
+                                 + ", parameters: " + megabytes(parameters) + ")");
+    }
+    plan.tile = tile;
+    plan.ld = tile;
+    plan.peak = fixed + std::max(shuffle, tile_buffers*tile*row);
+    return plan;
+}
+
+}
+}
@@ -0,0 +1,156 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "neo_ica/tools/numa.h"
+#include "neo_ica/tools/parallel.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+void thread_frame_range(int64_t off, int64_t NS, int64_t granularity, int tid, int nthreads, int64_t & begin, int64_t & end){
+    int64_t nblocks = (NS + granularity - 1)/granularity;
+    int64_t chunk = nblocks/nthreads;
+    int64_t remainder = nblocks%nthreads;
+    int64_t first = tid*chunk + std::min<int64_t>(tid, remainder);
+    int64_t last = first + chunk + ((tid < remainder)?1:0);
+    begin = off + std::min(first*granularity, NS);
+    end = off + std::min(last*granularity, NS);
+}
+
+#ifdef __linux__
+
+namespace{
+
+    //Parses a sysfs CPU list such as "0-3,8-11"
+    std::vector<int> parse_cpulist(std::string const & list){
+        std::vector<int> res;
+        std::istringstream iss(list);
+        std::string range;
+        while(std::getline(iss, range, ',')){
+            if(range.empty())
+                continue;
+            size_t dash = range.find('-');
+            int first = std::atoi(range.substr(0, dash).c_str());
+            int last = (dash==std::string::npos)?first:std::atoi(range.substr(dash+1).c_str());
+            for(int cpu = first ; cpu <= last ; ++cpu)
+                res.push_back(cpu);
+        }
+        return res;
+    }
+
+    std::vector<int> current_affinity(){
+        std::vector<int> res;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(sched_getaffinity(0, sizeof(set), &set)==0)
+            for(int cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu)
+                if(CPU_ISSET(cpu, &set))
+                    res.push_back(cpu);
+        return res;
+    }
+
+    bool set_affinity(std::vector<int> const & cpus){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(size_t i = 0 ; i < cpus.size() ; ++i)
+            CPU_SET(cpus[i], &set);
+        return sched_setaffinity(0, sizeof(set), &set)==0;
+    }
+
+    numa_topology discover(){
+        numa_topology res;
+        std::vector<int> allowed_list = current_affinity();
+        std::set<int> allowed(allowed_list.begin(), allowed_list.end());
+        for(int node = 0 ; ; ++node){
+            std::ostringstream path;
+            path << "/sys/devices/system/node/node" << node << "/cpulist";
+            std::ifstream in(path.str().c_str());
+            if(!in)
+                break;
+            std::string list;
+            std::getline(in, list);
+            std::vector<int> cpus = parse_cpulist(list);
+            std::vector<int> usable;
+            for(size_t i = 0 ; i < cpus.size() ; ++i)
+                if(allowed.count(cpus[i]))
+                    usable.push_back(cpus[i]);
+            if(!usable.empty())
+                res.nodes.push_back(usable);
+        }
+        if(res.nodes.empty() && !allowed_list.empty())
+            res.nodes.push_back(allowed_list);
+        return res;
+    }
+
+}
+
+numa_topology const & numa_topology::get(){
+    static numa_topology instance = discover();
+    return instance;
+}
+
+scoped_thread_affinity::scoped_thread_affinity(bool enabled) : pinned_(false){
+    if(!enabled)
+        return;
+    numa_topology const & topology = numa_topology::get();
+    std::vector<int> cpus;
+    for(size_t n = 0 ; n < topology.nodes.size() ; ++n)
+        cpus.insert(cpus.end(), topology.nodes[n].begin(), topology.nodes[n].end());
+    if(cpus.empty())
+        return;
+
+    previous_.resize(thread_pool::get().size());
+    std::atomic<bool> success(true);
+    parallel_run([&](int tid, int){
+        previous_[tid] = current_affinity();
+        //Threads beyond the number of CPUs wrap around
+        std::vector<int> target(1, cpus[tid%cpus.size()]);
+        if(!set_affinity(target))
+            success = false;
+    });
+    pinned_ = success;
+}
+
+scoped_thread_affinity::~scoped_thread_affinity(){
+    if(previous_.empty())
+        return;
+    parallel_run([&](int tid, int){
+        if(tid < (int)previous_.size() && !previous_[tid].empty())
+            set_affinity(previous_[tid]);
+    });
+}
+
+#else
+
+numa_topology const & numa_topology::get(){
+    static numa_topology instance;
+    return instance;
+}
+
+scoped_thread_affinity::scoped_thread_affinity(bool) : pinned_(false){ }
+
+scoped_thread_affinity::~scoped_thread_affinity(){ }
+
+#endif
+
+}
+}
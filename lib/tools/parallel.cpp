@@ -0,0 +1,141 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <immintrin.h>
+#include <algorithm>
+
+#include "neo_ica/tools/parallel.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+namespace{
+
+    //Spin iterations before parking (tens of microseconds), yielding now and then for oversubscribed hosts
+    static const int spin_iterations = 1 << 14;
+    static const int yield_period = 64;
+
+    thread_local int worker_id = 0;
+    thread_local bool in_region = false;
+
+    template<class Predicate>
+    bool spin_until(Predicate const & done){
+        for(int i = 0 ; i < spin_iterations ; ++i){
+            if(done())
+                return true;
+            if(i%yield_period==yield_period-1)
+                std::this_thread::yield();
+            else
+                _mm_pause();
+        }
+        return done();
+    }
+
+}
+
+thread_pool & thread_pool::get(){
+    static thread_pool instance;
+    return instance;
+}
+
+thread_pool::thread_pool() : fn_(NULL), arg_(NULL), generation_(0), pending_(0), parked_(0), stop_(false){
+    resize((int)std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+thread_pool::~thread_pool(){
+    stop();
+}
+
+int thread_pool::current_thread(){
+    return worker_id;
+}
+
+bool thread_pool::in_parallel_region(){
+    return in_region;
+}
+
+void thread_pool::stop(){
+    stop_.store(true);
+    generation_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(park_mutex_);
+    }
+    park_cv_.notify_all();
+    for(size_t i = 0 ; i < workers_.size() ; ++i)
+        workers_[i].join();
+    workers_.clear();
+    stop_.store(false);
+}
+
+void thread_pool::resize(int nthreads){
+    nthreads = std::max(nthreads, 1);
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    if(nthreads==size())
+        return;
+    stop();
+    //A worker that starts after the first region is published must still run it
+    uint64_t generation = generation_.load();
+    for(int tid = 1 ; tid < nthreads ; ++tid)
+        workers_.push_back(std::thread(&thread_pool::work, this, tid, generation));
+}
+
+void thread_pool::work(int tid, uint64_t seen){
+    worker_id = tid;
+    in_region = true;
+    while(true){
+        //Spin, then park until the next region
+        if(!spin_until([&]{ return generation_.load(std::memory_order_acquire)!=seen; })){
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_.fetch_add(1);
+            while(generation_.load()==seen)
+                park_cv_.wait(lock);
+            parked_.fetch_sub(1);
+        }
+        seen = generation_.load(std::memory_order_acquire);
+        if(stop_.load())
+            return;
+        fn_(arg_, tid, size());
+        pending_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void thread_pool::run(void (*fn)(void const *, int, int), void const * arg){
+    if(in_region || workers_.empty() || !run_mutex_.try_lock()){
+        fn(arg, 0, 1);
+        return;
+    }
+    fn_ = fn;
+    arg_ = arg;
+    pending_.store((int)workers_.size(), std::memory_order_relaxed);
+    generation_.fetch_add(1);
+    if(parked_.load() > 0){
+        std::lock_guard<std::mutex> lock(park_mutex_);
+        park_cv_.notify_all();
+    }
+
+    //Joins the workers and releases the pool even if the caller's share throws
+    struct join_guard{
+        thread_pool & pool;
+        ~join_guard(){
+            in_region = false;
+            if(!spin_until([&]{ return pool.pending_.load(std::memory_order_acquire)==0; }))
+                while(pool.pending_.load(std::memory_order_acquire)!=0)
+                    std::this_thread::yield();
+            pool.run_mutex_.unlock();
+        }
+    } guard = {*this};
+
+    in_region = true;
+    fn(arg, 0, size());
+}
+
+}
+}
@@ -0,0 +1,140 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/perf_counters.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+const char* hardware_event_name(hardware_event event){
+    switch(event){
+        case HW_CYCLES: return "cycles";
+        case HW_INSTRUCTIONS: return "instructions";
+        case HW_LLC_REFERENCES: return "llc_references";
+        case HW_LLC_MISSES: return "llc_misses";
+        default: return "unknown";
+    }
+}
+
+hardware_counters & hardware_counters::get(){
+    static hardware_counters instance;
+    return instance;
+}
+
+#ifdef __linux__
+
+namespace{
+
+    int open_event(hardware_event event){
+        static const uint64_t configs[N_HW_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES};
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[event];
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        //Calling thread, any CPU
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+}
+
+bool hardware_counters::open(){
+    close();
+    int nthreads = thread_pool::get().size();
+    fds_.assign(nthreads*N_HW_EVENTS, -1);
+    std::atomic<int> error(0);
+    parallel_run([&](int tid, int){
+        for(int e = 0 ; e < N_HW_EVENTS ; ++e){
+            int fd = open_event((hardware_event)e);
+            fds_[tid*N_HW_EVENTS + e] = fd;
+            if(fd < 0)
+                error = errno;
+        }
+    });
+    for(int e = 0 ; e < N_HW_EVENTS ; ++e){
+        available_[e] = true;
+        for(int t = 0 ; t < nthreads ; ++t)
+            available_[e] = available_[e] && fds_[t*N_HW_EVENTS + e] >= 0;
+        enabled_ = enabled_ || available_[e];
+    }
+    if(!enabled_)
+        status_ = std::string("unavailable (") + std::strerror(error) + ")";
+    else if(error)
+        status_ = std::string("partial (") + std::strerror(error) + ")";
+    else
+        status_ = "available";
+    return enabled_;
+}
+
+void hardware_counters::close(){
+    for(size_t i = 0 ; i < fds_.size() ; ++i)
+        if(fds_[i] >= 0)
+            ::close(fds_[i]);
+    fds_.clear();
+    std::fill(available_, available_ + N_HW_EVENTS, false);
+    enabled_ = false;
+    status_ = "closed";
+}
+
+void hardware_counters::read(uint64_t* values) const{
+    std::fill(values, values + N_HW_EVENTS, 0);
+    for(size_t i = 0 ; i < fds_.size() ; ++i){
+        int e = i%N_HW_EVENTS;
+        if(!available_[e])
+            continue;
+        //value, time enabled, time running
+        uint64_t buf[3];
+        if(::read(fds_[i], buf, sizeof(buf)) != sizeof(buf))
+            continue;
+        if(buf[2] > 0 && buf[2] < buf[1])
+            values[e] += (uint64_t)((double)buf[0]*buf[1]/buf[2]);
+        else
+            values[e] += buf[0];
+    }
+}
+
+#else
+
+bool hardware_counters::open(){
+    std::fill(available_, available_ + N_HW_EVENTS, false);
+    enabled_ = false;
+    status_ = "unavailable (perf_event_open requires Linux)";
+    return false;
+}
+
+void hardware_counters::close(){
+    enabled_ = false;
+    status_ = "closed";
+}
+
+void hardware_counters::read(uint64_t* values) const{
+    std::fill(values, values + N_HW_EVENTS, 0);
+}
+
+#endif
+
+}
+}
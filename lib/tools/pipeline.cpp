@@ -0,0 +1,80 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include "neo_ica/tools/pipeline.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+bounded_queue::bounded_queue(size_t capacity){
+    size_t size = 1;
+    while(size < capacity)
+        size *= 2;
+    cells_ = new cell[size];
+    mask_ = size - 1;
+    for(size_t i = 0 ; i < size ; ++i)
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    enqueue_.value.store(0, std::memory_order_relaxed);
+    dequeue_.value.store(0, std::memory_order_relaxed);
+}
+
+bounded_queue::~bounded_queue(){
+    delete[] cells_;
+}
+
+//A cell is free for position pos when its sequence is pos, and holds a value for pos when it is pos+1
+bool bounded_queue::push(int64_t value){
+    uint64_t pos = enqueue_.value.load(std::memory_order_relaxed);
+    cell* c;
+    while(true){
+        c = &cells_[pos & mask_];
+        int64_t diff = (int64_t)(c->sequence.load(std::memory_order_acquire) - pos);
+        if(diff==0){
+            if(enqueue_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+            return false;
+        else
+            pos = enqueue_.value.load(std::memory_order_relaxed);
+    }
+    c->value = value;
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool bounded_queue::pop(int64_t & value){
+    uint64_t pos = dequeue_.value.load(std::memory_order_relaxed);
+    cell* c;
+    while(true){
+        c = &cells_[pos & mask_];
+        int64_t diff = (int64_t)(c->sequence.load(std::memory_order_acquire) - (pos + 1));
+        if(diff==0){
+            if(dequeue_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+            return false;
+        else
+            pos = dequeue_.value.load(std::memory_order_relaxed);
+    }
+    value = c->value;
+    c->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+}
+
+pipeline::pipeline(int64_t n_items, int n_slots) : n_items_(n_items), n_slots_(n_slots), free_(n_slots), ready_(n_slots), next_(0), consumed_(0){
+    for(int s = 0 ; s < n_slots_ ; ++s)
+        free_.push(s);
+}
+
+}
+}
@@ -0,0 +1,127 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <iomanip>
+
+#include "neo_ica/tools/memory.h"
+#include "neo_ica/tools/profiler.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+const char* phase_name(phase_type phase){
+    switch(phase){
+        case PHASE_GEMM: return "gemm";
+        case PHASE_GETRF: return "getrf";
+        case PHASE_GETRI: return "getri";
+        case PHASE_SYEV: return "syev";
+        case PHASE_DIST_MU: return "dist_mu";
+        case PHASE_DIST_PHI: return "dist_phi";
+        case PHASE_DIST_DPHI: return "dist_dphi";
+        case PHASE_ELEMENTWISE: return "elementwise";
+        case PHASE_PIPELINE: return "pipeline";
+        case PHASE_FUSED: return "fused";
+        case PHASE_REDUCTION: return "reduction";
+        case PHASE_VALUE_GRADIENT: return "value_gradient";
+        case PHASE_HV_PRODUCT: return "hv_product";
+        case PHASE_GRADIENT_VARIANCE: return "gradient_variance";
+        case PHASE_HV_PRODUCT_VARIANCE: return "hv_product_variance";
+        case PHASE_LINE_SEARCH: return "line_search";
+        case PHASE_CONJUGATE_GRADIENT: return "conjugate_gradient";
+        case PHASE_WHITEN: return "whiten";
+        case PHASE_SHUFFLE: return "shuffle";
+        case PHASE_STRATIFY: return "stratify";
+        default: return "unknown";
+    }
+}
+
+bool is_kernel(phase_type phase){
+    return phase <= PHASE_REDUCTION;
+}
+
+profiler & profiler::get(){
+    static profiler instance;
+    return instance;
+}
+
+void profiler::reset(){
+    for(int i = 0 ; i < N_PHASES ; ++i)
+        counters_[i] = phase_counters();
+}
+
+namespace{
+
+    //IPC, LLC miss rate and an estimate of the DRAM traffic (one cache line per LLC miss)
+    void hardware_to_json(std::ostream & os, phase_counters const & c){
+        hardware_counters const & hw = hardware_counters::get();
+        uint64_t const * v = c.hardware;
+        double seconds = c.nanoseconds*1e-9;
+        os << ", \"hardware\": {";
+        bool first = true;
+        for(int e = 0 ; e < N_HW_EVENTS ; ++e){
+            if(!hw.available((hardware_event)e))
+                continue;
+            os << (first?"":", ") << "\"" << hardware_event_name((hardware_event)e) << "\": " << v[e];
+            first = false;
+        }
+        if(hw.available(HW_CYCLES) && hw.available(HW_INSTRUCTIONS))
+            os << ", \"ipc\": " << ((v[HW_CYCLES]>0)?(double)v[HW_INSTRUCTIONS]/v[HW_CYCLES]:0);
+        if(hw.available(HW_LLC_REFERENCES) && hw.available(HW_LLC_MISSES))
+            os << ", \"llc_miss_rate\": " << ((v[HW_LLC_REFERENCES]>0)?(double)v[HW_LLC_MISSES]/v[HW_LLC_REFERENCES]:0);
+        if(hw.available(HW_LLC_MISSES))
+            os << ", \"dram_gbytes_per_second_estimate\": " << ((seconds>0)?v[HW_LLC_MISSES]*64/seconds*1e-9:0);
+        os << "}";
+    }
+
+}
+
+void profiler::to_json(std::ostream & os) const{
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::setprecision(9);
+    os << "{" << std::endl;
+    os << "  \"hardware_counters\": \"" << hardware_counters::get().status() << "\"," << std::endl;
+    os << "  \"memory\": ";
+    memory_tracker::get().to_json(os);
+    os << "," << std::endl;
+    os << "  \"phases\": {";
+    bool first = true;
+    for(int i = 0 ; i < N_PHASES ; ++i){
+        phase_type phase = (phase_type)i;
+        phase_counters const & c = counters_[i];
+        if(c.calls==0)
+            continue;
+        double seconds = c.nanoseconds*1e-9;
+        os << (first?"":",") << std::endl;
+        os << "    \"" << phase_name(phase) << "\": {"
+           << "\"kind\": \"" << (is_kernel(phase)?"kernel":"stage") << "\", "
+           << "\"calls\": " << c.calls << ", "
+           << "\"seconds\": " << seconds << ", ";
+        if(is_kernel(phase))
+            os << "\"self_seconds\": " << c.self_nanoseconds*1e-9 << ", ";
+        os << "\"bytes\": " << c.bytes << ", "
+           << "\"flops\": " << c.flops << ", "
+           << "\"gflops_per_second\": " << ((seconds>0)?c.flops/seconds*1e-9:0) << ", "
+           << "\"gbytes_per_second\": " << ((seconds>0)?c.bytes/seconds*1e-9:0) << ", "
+           << "\"flops_per_byte\": " << ((c.bytes>0)?(double)c.flops/c.bytes:0);
+        if(c.hardware_samples > 0)
+            hardware_to_json(os, c);
+        os << "}";
+        first = false;
+    }
+    os << std::endl << "  }" << std::endl;
+    os << "}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}
+}
@@ -0,0 +1,117 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <omp.h>
+#include <cstddef>
+#include <sstream>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/threads.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+namespace{
+
+    void* find_symbol(const char* name){
+#ifndef _WIN32
+        return dlsym(RTLD_DEFAULT, name);
+#else
+        (void)name;
+        return NULL;
+#endif
+    }
+
+    blas_threading detect(){
+        blas_threading res;
+        res.uses_openmp = false;
+        res.get_ = NULL;
+        res.set_ = NULL;
+        //OpenBLAS : openblas_get_parallel() is 0 (sequential), 1 (pthreads) or 2 (OpenMP)
+        if(void* set = find_symbol("openblas_set_num_threads")){
+            res.library = "OpenBLAS";
+            res.set_ = reinterpret_cast<void (*)(int)>(set);
+            res.get_ = reinterpret_cast<int (*)()>(find_symbol("openblas_get_num_threads"));
+            if(void* parallel = find_symbol("openblas_get_parallel"))
+                res.uses_openmp = reinterpret_cast<int (*)()>(parallel)()==2;
+        }
+        else if(void* set = find_symbol("MKL_Set_Num_Threads")){
+            res.library = "MKL";
+            res.set_ = reinterpret_cast<void (*)(int)>(set);
+            res.get_ = reinterpret_cast<int (*)()>(find_symbol("MKL_Get_Max_Threads"));
+        }
+        return res;
+    }
+
+}
+
+blas_threading const & blas_threading::get(){
+    static blas_threading instance = detect();
+    return instance;
+}
+
+int blas_threading::get_num_threads() const{
+    return get_?get_():0;
+}
+
+bool blas_threading::set_num_threads(int nthreads) const{
+    if(!set_ || nthreads <= 0)
+        return false;
+    set_(nthreads);
+    return true;
+}
+
+scoped_thread_budget::scoped_thread_budget(int nthreads){
+    blas_threading const & blas = blas_threading::get();
+    previous_omp_ = omp_get_max_threads();
+    previous_blas_ = blas.get_num_threads();
+    previous_dynamic_ = omp_get_dynamic();
+    threads_ = (nthreads > 0)?nthreads:previous_omp_;
+    thread_pool::get().resize(threads_);
+    //Exact team sizes, the frame partitions of the kernels and of the first touch must agree
+    omp_set_dynamic(0);
+    omp_set_num_threads(threads_);
+    blas.set_num_threads(threads_);
+}
+
+scoped_thread_budget::~scoped_thread_budget(){
+    omp_set_dynamic(previous_dynamic_);
+    omp_set_num_threads(previous_omp_);
+    blas_threading::get().set_num_threads(previous_blas_);
+}
+
+scoped_blas_threads::scoped_blas_threads(int nthreads){
+    blas_threading const & blas = blas_threading::get();
+    previous_ = blas.get_num_threads();
+    blas.set_num_threads(nthreads);
+}
+
+scoped_blas_threads::~scoped_blas_threads(){
+    blas_threading::get().set_num_threads(previous_);
+}
+
+std::string scoped_thread_budget::description() const{
+    blas_threading const & blas = blas_threading::get();
+    std::ostringstream oss;
+    oss << "Threads: " << threads_ << " (pool)";
+    if(blas.library.empty())
+        oss << ", BLAS threading unknown";
+    else
+        oss << ", " << blas.get_num_threads() << " (" << blas.library << (blas.uses_openmp?", OpenMP":", own pool") << ")";
+    return oss.str();
+}
+
+}
+}
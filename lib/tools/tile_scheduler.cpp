@@ -0,0 +1,60 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+
+#include "neo_ica/tools/numa.h"
+#include "neo_ica/tools/round.hpp"
+#include "neo_ica/tools/tile_scheduler.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+namespace{
+
+    //Enough tiles per thread to balance the load, tiles long enough to amortize taking them
+    static const int64_t tiles_per_thread = 8;
+    static const int64_t min_block = 256;
+
+}
+
+tile_scheduler::tile_scheduler(int64_t NC, int64_t off, int64_t NS, int64_t granularity, int nthreads) : NC_(NC), off_(off), NS_(NS), nthreads_(std::max(nthreads, 1)){
+    int64_t target_blocks = std::max<int64_t>(1, (tiles_per_thread*nthreads_ + NC_ - 1)/NC_);
+    block_ = round_to_next_multiple<int64_t>(std::max<int64_t>((NS_ + target_blocks - 1)/target_blocks, min_block), granularity);
+    n_blocks_ = std::max<int64_t>(1, (NS_ + block_ - 1)/block_);
+
+    queues_ = new queue[nthreads_];
+    for(int t = 0 ; t < nthreads_ ; ++t){
+        int64_t begin, end;
+        thread_frame_range(0, n_blocks_, 1, t, nthreads_, begin, end);
+        queues_[t].next = begin*NC_;
+        queues_[t].end = end*NC_;
+    }
+}
+
+tile_scheduler::~tile_scheduler(){
+    delete[] queues_;
+}
+
+bool tile_scheduler::next(int tid, int64_t & tile){
+    for(int i = 0 ; i < nthreads_ ; ++i){
+        queue & q = queues_[(tid + i)%nthreads_];
+        if(q.next.load(std::memory_order_relaxed) >= q.end)
+            continue;
+        tile = q.next.fetch_add(1, std::memory_order_relaxed);
+        if(tile < q.end)
+            return true;
+    }
+    return false;
+}
+
+}
+}
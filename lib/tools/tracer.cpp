@@ -0,0 +1,71 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <iomanip>
+
+#include "neo_ica/tools/parallel.h"
+#include "neo_ica/tools/tracer.h"
+
+namespace neo_ica
+{
+namespace tools
+{
+
+int current_thread(){
+    return thread_pool::current_thread();
+}
+
+bool in_parallel_region(){
+    return thread_pool::in_parallel_region();
+}
+
+tracer & tracer::get(){
+    static tracer instance;
+    return instance;
+}
+
+void tracer::enable(bool value){
+    if(value){
+        events_.clear();
+        events_.resize(thread_pool::get().size());
+        origin_ = clock::now();
+    }
+    enabled_ = value;
+}
+
+void tracer::to_json(std::ostream & os) const{
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    bool first = true;
+    for(size_t tid = 0 ; tid < events_.size() ; ++tid){
+        if(events_[tid].empty())
+            continue;
+        os << (first?"":",\n")
+           << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+           << ", \"args\": {\"name\": \"" << ((tid==0)?"master":"worker") << " " << tid << "\"}}";
+        first = false;
+        for(size_t i = 0 ; i < events_[tid].size() ; ++i){
+            event const & e = events_[tid][i];
+            os << ",\n{\"name\": \"" << e.name << "\", \"cat\": \"neo_ica\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+               << ", \"ts\": " << e.begin*1e-3 << ", \"dur\": " << (e.end - e.begin)*1e-3;
+            if(e.arg_name)
+                os << ", \"args\": {\"" << e.arg_name << "\": " << e.arg << "}";
+            os << "}";
+        }
+    }
+    os << std::endl << "]}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}
+}
@@ -87,6 +87,82 @@ void fill_options(mxArray* options_mx, neo_ica_options_type & options){
         options.opts.extended = (bool)mxGetScalar(extended);
     if(mxArray * tol = mxGetField(options_mx, 0, "tol"))
         options.opts.tol = mxGetScalar(tol);
+    if(mxArray * profile = mxGetField(options_mx, 0, "profile"))
+        options.opts.profile = (bool)mxGetScalar(profile);
+    if(mxArray * hardware_counters = mxGetField(options_mx, 0, "hardware_counters"))
+        options.opts.hardware_counters = (bool)mxGetScalar(hardware_counters);
+    if(mxArray * max_memory = mxGetField(options_mx, 0, "max_memory"))
+        options.opts.max_memory = (size_t)mxGetScalar(max_memory);
+    if(mxArray * huge_pages = mxGetField(options_mx, 0, "huge_pages"))
+        options.opts.huge_pages = (bool)mxGetScalar(huge_pages);
+    if(mxArray * prefault = mxGetField(options_mx, 0, "prefault"))
+        options.opts.prefault = (bool)mxGetScalar(prefault);
+    if(mxArray * pin_threads = mxGetField(options_mx, 0, "pin_threads"))
+        options.opts.pin_threads = (bool)mxGetScalar(pin_threads);
+    if(mxArray * pipeline = mxGetField(options_mx, 0, "pipeline"))
+        options.opts.pipeline = (bool)mxGetScalar(pipeline);
+    if(mxArray * fused_kernels = mxGetField(options_mx, 0, "fused_kernels"))
+        options.opts.fused_kernels = (bool)mxGetScalar(fused_kernels);
+    if(mxArray * frame_blocked = mxGetField(options_mx, 0, "frame_blocked"))
+        options.opts.frame_blocked = (bool)mxGetScalar(frame_blocked);
+    if(mxArray * storage = mxGetField(options_mx, 0, "storage")){
+        char * str = mxArrayToString(storage);
+        bool known = true;
+        if(are_string_equal(str,"fp16"))
+            options.opts.storage = neo_ica::STORAGE_FP16;
+        else if(are_string_equal(str,"bf16"))
+            options.opts.storage = neo_ica::STORAGE_BF16;
+        else if(are_string_equal(str,"native"))
+            options.opts.storage = neo_ica::STORAGE_NATIVE;
+        else
+            known = false;
+        mxFree(str);
+        if(!known)
+            mexErrMsgTxt("Invalid storage : expected 'native', 'fp16' or 'bf16'");
+    }
+    if(mxArray * mixed_precision = mxGetField(options_mx, 0, "mixed_precision"))
+        options.opts.mixed_precision = (bool)mxGetScalar(mixed_precision);
+    if(mxArray * escalation = mxGetField(options_mx, 0, "escalation"))
+        options.opts.escalation = mxGetScalar(escalation);
+    if(mxArray * accuracy = mxGetField(options_mx, 0, "accuracy")){
+        char * str = mxArrayToString(accuracy);
+        bool known = true;
+        if(are_string_equal(str,"exact"))
+            options.opts.accuracy = neo_ica::ACCURACY_EXACT;
+        else if(are_string_equal(str,"fmath"))
+            options.opts.accuracy = neo_ica::ACCURACY_FMATH;
+        else if(are_string_equal(str,"fast"))
+            options.opts.accuracy = neo_ica::ACCURACY_FAST;
+        else
+            known = false;
+        mxFree(str);
+        if(!known)
+            mexErrMsgTxt("Invalid accuracy : expected 'exact', 'fmath' or 'fast'");
+    }
+    if(mxArray * freeze_tol = mxGetField(options_mx, 0, "freeze_tol"))
+        options.opts.freeze_tol = mxGetScalar(freeze_tol);
+    if(mxArray * freeze_period = mxGetField(options_mx, 0, "freeze_period"))
+        options.opts.freeze_period = (size_t)mxGetScalar(freeze_period);
+    if(mxArray * adaptive_sampling = mxGetField(options_mx, 0, "adaptive_sampling"))
+        options.opts.adaptive_sampling = (bool)mxGetScalar(adaptive_sampling);
+    if(mxArray * early_exit = mxGetField(options_mx, 0, "early_exit"))
+        options.opts.early_exit = (bool)mxGetScalar(early_exit);
+    if(mxArray * importance_sampling = mxGetField(options_mx, 0, "importance_sampling"))
+        options.opts.importance_sampling = (bool)mxGetScalar(importance_sampling);
+    if(mxArray * coreset_fraction = mxGetField(options_mx, 0, "coreset_fraction"))
+        options.opts.coreset_fraction = mxGetScalar(coreset_fraction);
+    if(mxArray * coreset_polish = mxGetField(options_mx, 0, "coreset_polish"))
+        options.opts.coreset_polish = (size_t)mxGetScalar(coreset_polish);
+    if(mxArray * profile_file = mxGetField(options_mx, 0, "profile_file")){
+        char * str = mxArrayToString(profile_file);
+        options.opts.profile_file = str;
+        mxFree(str);
+    }
+    if(mxArray * trace_file = mxGetField(options_mx, 0, "trace_file")){
+        char * str = mxArrayToString(trace_file);
+        options.opts.trace_file = str;
+        mxFree(str);
+    }
 }
 
 void printErrorExit(std::string const & str){
@@ -56,7 +56,7 @@ def main():
                     libraries=libraries,
                     library_dirs=library_dirs,
                     extra_compile_args=['-std=c++11', '-fopenmp', '-msse4'],
-                    extra_link_args=['-lgomp', '-Wl,-soname=_ica.so'],
+                    extra_link_args=['-lgomp', '-ldl', '-pthread', '-Wl,-soname=_ica.so'],
                     include_dirs=include)
     
     #Setup
@@ -0,0 +1,74 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "test-utils.hpp"
+#include "neo_ica/ica.h"
+#include "neo_ica/math/math.h"
+
+using namespace neo_ica;
+
+//Error bound of a tier : ulps of single precision at the exact value, or an absolute error, whichever is larger
+struct bound{
+    double ulps;
+    double absolute;
+};
+
+static double ulp(double v){
+    float f = (float)std::fabs(v);
+    return std::nextafter(f, std::numeric_limits<float>::infinity()) - f;
+}
+
+static double tanh_ref(double x)
+{ return std::tanh(x); }
+
+static double log_1pe_ref(double x)
+{ return ((x > 0)?x:0) + std::log1p(std::exp(-std::fabs(x))); }
+
+//Worst error of f over xs against the double precision reference, relative to the bound (at most 1 to pass)
+template<class F>
+double worst_error(std::vector<float> const & xs, F const & f, double (*ref)(double), bound const & b){
+    double worst = 0;
+    for(size_t i = 0 ; i + 4 <= xs.size() ; i += 4){
+        float y[4];
+        _mm_storeu_ps(y, f(_mm_loadu_ps(&xs[i])));
+        for(int l = 0 ; l < 4 ; ++l){
+            double exact = ref(xs[i + l]);
+            double allowed = std::max(b.ulps*ulp(exact), b.absolute);
+            worst = std::max(worst, std::fabs(y[l] - exact)/allowed);
+        }
+    }
+    return worst;
+}
+
+/* The transcendentals of the accuracy tiers against libm in double precision, within the bounds documented
+ * by neo_ica::accuracy_tier : over [-30, 30], and over small magnitudes where the bounds differ */
+int main(){
+    uint64_t state = 1;
+    std::vector<float> wide(1 << 18), small(1 << 16);
+    for(size_t i = 0 ; i < wide.size() ; ++i)
+        wide[i] = (float)(30*test_uniform(state));
+    double lo = std::log(1e-6), hi = std::log(1./16);
+    for(size_t i = 0 ; i < small.size() ; ++i)
+        small[i] = (float)(std::exp(lo + (0.5 + 0.5*test_uniform(state))*(hi - lo))*((i%2)?-1:1));
+
+    bound exact = {2.2, 0}, fmath = {38, 2e-7}, fmath_log = {38, 5e-7}, fast = {1616, 0}, fast_small = {3.3, 0};
+    NEO_ICA_CHECK(worst_error(wide, math::exact_tier::tanh, tanh_ref, exact) <= 1);
+    NEO_ICA_CHECK(worst_error(small, math::exact_tier::tanh, tanh_ref, exact) <= 1);
+    NEO_ICA_CHECK(worst_error(wide, math::exact_tier::log_1pe, log_1pe_ref, exact) <= 1);
+    NEO_ICA_CHECK(worst_error(wide, math::fmath_tier::tanh, tanh_ref, fmath) <= 1);
+    NEO_ICA_CHECK(worst_error(small, math::fmath_tier::tanh, tanh_ref, fmath) <= 1);
+    NEO_ICA_CHECK(worst_error(wide, math::fmath_tier::log_1pe, log_1pe_ref, fmath_log) <= 1);
+    NEO_ICA_CHECK(worst_error(wide, math::fast_tier::tanh, tanh_ref, fast) <= 1);
+    NEO_ICA_CHECK(worst_error(small, math::fast_tier::tanh, tanh_ref, fast_small) <= 1);
+    return test_result("accuracy");
+}
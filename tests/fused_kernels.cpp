@@ -0,0 +1,77 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "test-utils.hpp"
+#include "neo_ica/backend/backend.hpp"
+#include "neo_ica/dist.h"
+#include "neo_ica/tools/reduction.hpp"
+
+using namespace neo_ica;
+
+/* The fused kernels against the path of the GEMMs and the tile kernels : Z = X*W, mu and phi(Z) by the
+ * nonlinearity, then X'*phi(Z) ; likewise X'*(dphi(Z).*(X*V)) for the Hessian-vector products. Channels
+ * with a specialized kernel and without, over a window that starts off the frame blocks */
+template<template<class> class F>
+void check_fused(int64_t NC, uint64_t & state){
+    const int64_t NF = 1111, off = 37, NS = 1000;
+    std::vector<float> X(NC*NF), W(NC*NC), V(NC*NC), signs(NC);
+    for(int64_t i = 0 ; i < NC*NF ; ++i)
+        X[i] = (float)test_uniform(state);
+    for(int64_t i = 0 ; i < NC ; ++i)
+        for(int64_t j = 0 ; j < NC ; ++j){
+            W[i*NC + j] = (float)((i==j) + 0.2*test_uniform(state));
+            V[i*NC + j] = (float)test_uniform(state);
+        }
+    for(int64_t c = 0 ; c < NC ; ++c)
+        signs[c] = (c%3==0)?-1:1;
+    dist<float, F> fn(NC, NF, ACCURACY_FMATH);
+    tools::whitened_data<float> data(X.data(), NC, NF, false, STORAGE_NATIVE);
+
+    //GEMM path, Z and RZ over the window only
+    std::vector<float> Z(NC*NS), RZ(NC*NS), mu(NC), phixT(NC*NC), psixT(NC*NC);
+    dist<float, F> tile(NC, NS, ACCURACY_FMATH);
+    backend<float>::gemm(NoTrans,NoTrans,NS,NC,NC,1,X.data() + off,NF,W.data(),NC,0,Z.data(),NS);
+    backend<float>::gemm(NoTrans,NoTrans,NS,NC,NC,1,X.data() + off,NF,V.data(),NC,0,RZ.data(),NS);
+    tile.mu(0,NS,Z.data(),signs.data(),mu.data());
+    std::vector<float> Y(Z);
+    tile.phi(0,NS,Y.data(),signs.data(),Y.data());
+    tools::tall_skinny_product(NC,NC,NS,1.f,X.data() + off,NF,Y.data(),NS,0.f,phixT.data());
+    tile.dphi(0,NS,Z.data(),signs.data(),Z.data());
+    for(int64_t i = 0 ; i < NC*NS ; ++i)
+        Z[i] *= RZ[i];
+    tools::tall_skinny_product(NC,NC,NS,1.f,X.data() + off,NF,Z.data(),NS,0.f,psixT.data());
+
+    std::vector<float> fused_mu(NC), fused_phixT(NC*NC), fused_psixT(NC*NC);
+    NEO_ICA_CHECK(fn.fused_value_gradient(data, off, NS, W.data(), signs.data(), fused_mu.data(), fused_phixT.data()));
+    NEO_ICA_CHECK(fn.fused_hv_product(data, off, NS, W.data(), V.data(), signs.data(), fused_psixT.data()));
+
+    //Sums over NS frames of terms of order 1, in single precision
+    NEO_ICA_CHECK(max_abs_diff(NC, fused_mu.data(), mu.data()) < 1e-5);
+    NEO_ICA_CHECK(max_abs_diff(NC*NC, fused_phixT.data(), phixT.data()) < 1e-3);
+    NEO_ICA_CHECK(max_abs_diff(NC*NC, fused_psixT.data(), psixT.data()) < 1e-3);
+}
+
+int main(){
+    if(!has_fused_kernels<float>(4)){
+        std::cout << "fused_kernels : skipped, no fused kernels on this CPU" << std::endl;
+        return EXIT_SUCCESS;
+    }
+    NEO_ICA_CHECK(!has_fused_kernels<double>(4));
+    uint64_t state = 1;
+    int64_t const channels[] = {4, 7, 16, 32};
+    for(int64_t NC : channels){
+        check_fused<infomax>(NC, state);
+        check_fused<extended_infomax>(NC, state);
+    }
+    return test_result("fused_kernels");
+}
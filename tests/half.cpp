@@ -0,0 +1,66 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "test-utils.hpp"
+#include "neo_ica/tools/half.h"
+
+using namespace neo_ica;
+
+/* Conversions to the 16-bit storages round to nearest : the relative error is at most half an ULP, 2^-11
+ * for half precision (normal range) and 2^-8 for bfloat16, and widening a stored value then narrowing it
+ * again is exact. Lengths that are not multiples of the vectors exercise the tails */
+template<class T>
+void check_storage(storage_type storage, double bound, double smallest, double largest, uint64_t & state){
+    const int64_t n = 1003;
+    std::vector<T> x(n), back(n), again(n);
+    std::vector<uint16_t> stored(n), restored(n);
+    for(int64_t i = 0 ; i < n ; ++i){
+        double magnitude = std::exp(std::log(smallest) + (0.5 + 0.5*test_uniform(state))*(std::log(largest) - std::log(smallest)));
+        x[i] = (T)((test_uniform(state) < 0?-1:1)*magnitude);
+    }
+    tools::narrow(storage, x.data(), n, stored.data());
+    tools::widen(storage, stored.data(), n, back.data());
+    double worst = 0;
+    for(int64_t i = 0 ; i < n ; ++i)
+        worst = std::max(worst, std::fabs((double)back[i] - (double)x[i])/std::fabs((double)x[i]));
+    //Double precision goes through single precision, rounding twice
+    NEO_ICA_CHECK(worst <= bound*(1 + std::ldexp(1., -20)));
+    tools::narrow(storage, back.data(), n, restored.data());
+    NEO_ICA_CHECK(restored==stored);
+    tools::widen(storage, restored.data(), n, again.data());
+    NEO_ICA_CHECK(again==back);
+}
+
+int main(){
+    uint64_t state = 1;
+    NEO_ICA_CHECK(tools::storage_size(STORAGE_NATIVE)==0);
+    NEO_ICA_CHECK(tools::storage_size(STORAGE_FP16)==2 && tools::storage_size(STORAGE_BF16)==2);
+    NEO_ICA_CHECK(tools::storage_supported(STORAGE_BF16));
+
+    check_storage<float>(STORAGE_BF16, std::ldexp(1., -8), 1e-30, 1e30, state);
+    check_storage<double>(STORAGE_BF16, std::ldexp(1., -8), 1e-30, 1e30, state);
+    if(tools::storage_supported(STORAGE_FP16)){
+        check_storage<float>(STORAGE_FP16, std::ldexp(1., -11), std::ldexp(1., -14), 65504, state);
+        check_storage<double>(STORAGE_FP16, std::ldexp(1., -11), std::ldexp(1., -14), 65504, state);
+
+        //Out of range, half precision saturates to infinity
+        float big[2] = {1e5f, -7e4f}, res[2];
+        uint16_t stored[2];
+        tools::narrow(STORAGE_FP16, big, 2, stored);
+        tools::widen(STORAGE_FP16, stored, 2, res);
+        NEO_ICA_CHECK(res[0]==std::numeric_limits<float>::infinity() && res[1]==-std::numeric_limits<float>::infinity());
+    }
+    else
+        std::cout << "half : no F16C, half precision skipped" << std::endl;
+    return test_result("half");
+}
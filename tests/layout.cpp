@@ -0,0 +1,65 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <vector>
+
+#include "test-utils.hpp"
+#include "neo_ica/tools/layout.hpp"
+
+using namespace neo_ica;
+
+/* Round trips through the frame-blocked layout : channel-major data converted to blocks and back, rows
+ * read and written over runs that straddle the blocks, unpacked windows, and the zeroed padding */
+template<class T>
+void check_blocked(int64_t NC, int64_t NF, uint64_t & state){
+    std::vector<T> rows(NC*NF), back(NC*NF), blocks(NC*tools::blocked_frames(NF), -1);
+    for(int64_t i = 0 ; i < NC*NF ; ++i)
+        rows[i] = (T)test_uniform(state);
+    tools::whitened_data<T> native(rows.data(), NC, NF, false, STORAGE_NATIVE);
+    tools::whitened_data<T> blocked(blocks.data(), NC, NF, true, STORAGE_NATIVE);
+    tools::whitened_data<T> copy(back.data(), NC, NF, false, STORAGE_NATIVE);
+
+    tools::convert(native, blocked);
+    for(int64_t c = 0 ; c < NC ; ++c)
+        for(int64_t f = 0 ; f < NF ; f += 7)
+            NEO_ICA_CHECK(blocks[tools::blocked_offset(NC, c, f)]==rows[c*NF + f]);
+    for(int64_t c = 0 ; c < NC ; ++c)
+        for(int64_t f = NF ; f < tools::blocked_frames(NF) ; ++f)
+            NEO_ICA_CHECK(blocks[tools::blocked_offset(NC, c, f)]==0);
+    tools::convert(blocked, copy);
+    NEO_ICA_CHECK(back==rows);
+
+    //Runs of frames that start and end inside blocks
+    std::vector<T> run(NF);
+    for(int64_t c = 0 ; c < NC ; ++c){
+        blocked.read(c, 5, NF - 9, run.data());
+        NEO_ICA_CHECK(std::equal(run.begin(), run.begin() + NF - 9, rows.begin() + c*NF + 5));
+        for(int64_t f = 0 ; f < NF - 9 ; ++f)
+            run[f] = -run[f];
+        blocked.write(c, 5, NF - 9, run.data());
+        NEO_ICA_CHECK(blocked.at(c, 4)==rows[c*NF + 4] && blocked.at(c, 5)==-rows[c*NF + 5]);
+        NEO_ICA_CHECK(blocked.at(c, NF - 5)==-rows[c*NF + NF - 5] && blocked.at(c, NF - 4)==rows[c*NF + NF - 4]);
+    }
+
+    //Window [t, t+n) into rows of ld frames
+    int64_t t = 21, n = NF - 40, ld = n + 3;
+    std::vector<T> window(NC*ld, 0);
+    native.unpack(t, n, window.data(), ld);
+    for(int64_t c = 0 ; c < NC ; ++c)
+        NEO_ICA_CHECK(std::equal(window.begin() + c*ld, window.begin() + c*ld + n, rows.begin() + c*NF + t));
+}
+
+int main(){
+    uint64_t state = 1;
+    check_blocked<float>(3, 1000, state);
+    check_blocked<float>(16, 4096, state);
+    check_blocked<double>(5, 999, state);
+    return test_result("layout");
+}
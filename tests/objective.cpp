@@ -0,0 +1,231 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "test-utils.hpp"
+#include "lib/log_likelihood.hpp"
+#include "lib/passes.hpp"
+#include "lib/stratified_objective.hpp"
+
+using namespace neo_ica;
+
+//Whitened-like data of NC super-gaussian channels, channel-major in double precision
+struct test_data{
+    test_data(int64_t NC, int64_t NF, uint64_t & state) : NC(NC), NF(NF), values(NC*NF),
+        data(values.data(), NC, NF, false, STORAGE_NATIVE), plan(tools::plan_memory(NC, NF, sizeof(double), 0, false, 0)){
+        for(int64_t i = 0 ; i < NC*NF ; ++i){
+            double u = test_uniform(state);
+            values[i] = 1.7*u*u*u;
+        }
+    }
+
+    //The frames of other at the given indices
+    test_data(test_data const & other, std::vector<int64_t> const & indices) : NC(other.NC), NF(indices.size()), values(NC*NF),
+        data(values.data(), NC, NF, false, STORAGE_NATIVE), plan(tools::plan_memory(NC, NF, sizeof(double), 0, false, 0)){
+        for(int64_t c = 0 ; c < NC ; ++c)
+            for(int64_t i = 0 ; i < NF ; ++i)
+                values[c*NF + i] = other.values[c*other.NF + indices[i]];
+    }
+
+    log_likelihood<double> * objective(bool cache_curvature) const{
+        tools::memory_plan p = plan;
+        p.cache_curvature = cache_curvature;
+        return new log_likelihood<double>(data, make_dist<double>(true, NC, p.ld, ACCURACY_FMATH), p, false, false);
+    }
+
+    //Near the identity, where the Hessian is positive definite
+    std::vector<double> parameters(uint64_t & state) const{
+        std::vector<double> W(NC*NC);
+        for(int64_t i = 0 ; i < NC ; ++i)
+            for(int64_t j = 0 ; j < NC ; ++j)
+                W[i*NC + j] = (i==j) + 0.1*test_uniform(state);
+        return W;
+    }
+
+    int64_t NC;
+    int64_t NF;
+    std::vector<double> values;
+    tools::whitened_data<double> data;
+    tools::memory_plan plan;
+};
+
+/* Hessian-vector products through the curvature cache against those recomputing dphi(X*W) : several products at
+ * the same W and window, then at another W, over another window, and with the variance */
+void check_curvature_cache(test_data const & d, uint64_t & state){
+    std::unique_ptr<log_likelihood<double>> cached(d.objective(true)), uncached(d.objective(false));
+    int64_t NC = d.NC;
+    std::vector<double> Hv_(NC*NC), expected_(NC*NC);
+    //The objective writes through references to pointers
+    double * Hv = Hv_.data(), * expected = expected_.data();
+    int64_t const windows[][2] = {{100, 2000}, {100, 2000}, {1500, 3000}};
+    for(auto const & w : windows){
+        std::vector<double> W = d.parameters(state);
+        for(int p = 0 ; p < 3 ; ++p){
+            std::vector<double> V = d.parameters(state);
+            umintl::hessian_vector_product tag(umintl::STOCHASTIC, w[1], w[0]);
+            (*cached)(W.data(), V.data(), Hv, tag);
+            (*uncached)(W.data(), V.data(), expected, tag);
+            NEO_ICA_CHECK(max_abs_diff(NC*NC, Hv, expected) < 1e-12);
+        }
+        std::vector<double> V = d.parameters(state);
+        umintl::hv_product_variance tag(umintl::STOCHASTIC, w[1], w[0]);
+        (*cached)(W.data(), V.data(), Hv, tag);
+        (*uncached)(W.data(), V.data(), expected, tag);
+        NEO_ICA_CHECK(max_abs_diff(NC*NC, Hv, expected) < 1e-12);
+    }
+}
+
+/* Early exit of the evaluations of trial steps : a step whose value meets the bound is evaluated in full, over
+ * any window, and one well above it is given up, the frames counted being those actually read */
+void check_early_exit(uint64_t & state){
+    test_data d(6, 20000, state);
+    int64_t NC = d.NC;
+    std::unique_ptr<log_likelihood<double>> objective(d.objective(false));
+    std::vector<double> grad_(NC*NC), expected_(NC*NC);
+    double * grad = grad_.data(), * expected = expected_.data();
+    for(int trial = 0 ; trial < 20 ; ++trial){
+        std::vector<double> W = d.parameters(state);
+        int64_t sample_size = d.NF/2 + trial*d.NF/40, offset = (d.NF - sample_size)*trial/20;
+        double value, expected_value;
+        (*objective)(W.data(), expected_value, expected, umintl::value_gradient(umintl::STOCHASTIC, sample_size, offset));
+        size_t read = 0;
+        bool complete = (*objective)(W.data(), value, grad, umintl::bounded_value_gradient(umintl::STOCHASTIC, sample_size, offset, expected_value, &read));
+        NEO_ICA_CHECK(complete);
+        NEO_ICA_CHECK(read==0);
+        //The SSE kernels of the fmath tier sum logp in single precision, over other runs of frames
+        NEO_ICA_CHECK(std::abs(value - expected_value) < 1e-8);
+        NEO_ICA_CHECK(max_abs_diff(NC*NC, grad, expected) < 1e-10);
+    }
+
+    typedef umintl_backend<double>::type BackendType;
+    umintl::detail::function_wrapper_impl<BackendType, log_likelihood<double> > wrapper(*objective, NC*NC, umintl::PROVIDED);
+    std::vector<double> W = d.parameters(state);
+    double value;
+    wrapper.compute_value_gradient(W.data(), value, grad, umintl::value_gradient(umintl::DETERMINISTIC, d.NF, 0));
+    NEO_ICA_CHECK(wrapper.n_datapoints_accessed()==(uint64_t)d.NF);
+    NEO_ICA_CHECK(!wrapper.compute_value_gradient(W.data(), value, grad, umintl::value_gradient(umintl::DETERMINISTIC, d.NF, 0), value - 1));
+    uint64_t read = wrapper.n_datapoints_accessed() - d.NF;
+    NEO_ICA_CHECK(read >= (uint64_t)d.NF/4 && read < (uint64_t)d.NF);
+}
+
+/* Stratified estimates when every stratum is sampled in full : the weighted means of the strata are the means
+ * over all the frames, and W is factored again for the next parameters */
+void check_strata(uint64_t & state){
+    test_data d(6, 5000, state);
+    int64_t NC = d.NC;
+    std::unique_ptr<log_likelihood<double>> objective(d.objective(false));
+    stratified_objective<double> strata(*objective, NC, d.NF);
+    std::vector<double> W = d.parameters(state), V = d.parameters(state);
+    strata.stratify(W.data(), 0);
+
+    std::vector<double> grad_(NC*NC), expected_(NC*NC);
+    double * grad = grad_.data(), * expected = expected_.data(), value, expected_value;
+    //The strata split the single precision sums of the fmath tier differently
+    for(int p = 0 ; p < 2 ; ++p){
+        (*objective)(W.data(), expected_value, expected, umintl::value_gradient(umintl::DETERMINISTIC, d.NF, 0));
+        strata(W.data(), value, grad, umintl::value_gradient(umintl::STOCHASTIC, d.NF, 0));
+        NEO_ICA_CHECK(std::abs(value - expected_value) < 1e-8);
+        NEO_ICA_CHECK(max_abs_diff(NC*NC, grad, expected) < 1e-8);
+        (*objective)(W.data(), V.data(), expected, umintl::hessian_vector_product(umintl::DETERMINISTIC, d.NF, 0));
+        strata(W.data(), V.data(), grad, umintl::hessian_vector_product(umintl::STOCHASTIC, d.NF, 0));
+        NEO_ICA_CHECK(max_abs_diff(NC*NC, grad, expected) < 1e-8);
+        W = d.parameters(state);
+    }
+}
+
+/* Early exit over strata : a sample meeting the bound is evaluated in full, as by the unbounded estimate, and one
+ * well above it gives up before reading all of its windows */
+void check_stratified_early_exit(uint64_t & state){
+    test_data d(6, 20000, state);
+    int64_t NC = d.NC, sample_size = 12000;
+    std::unique_ptr<log_likelihood<double>> objective(d.objective(false));
+    stratified_objective<double> strata(*objective, NC, d.NF);
+    std::vector<double> W = d.parameters(state);
+    strata.stratify(W.data(), 0);
+
+    std::vector<double> grad_(NC*NC), expected_(NC*NC);
+    double * grad = grad_.data(), * expected = expected_.data(), value, expected_value;
+    for(int trial = 0 ; trial < 5 ; ++trial){
+        int64_t offset = trial*d.NF/5;
+        strata(W.data(), expected_value, expected, umintl::value_gradient(umintl::STOCHASTIC, sample_size, offset));
+        size_t read = 0;
+        NEO_ICA_CHECK(strata(W.data(), value, grad, umintl::bounded_value_gradient(umintl::STOCHASTIC, sample_size, offset, expected_value, &read)));
+        NEO_ICA_CHECK(read==0);
+        NEO_ICA_CHECK(std::abs(value - expected_value) < 1e-8);
+        NEO_ICA_CHECK(max_abs_diff(NC*NC, grad, expected) < 1e-8);
+        W = d.parameters(state);
+    }
+
+    typedef umintl_backend<double>::type BackendType;
+    umintl::detail::function_wrapper_impl<BackendType, stratified_objective<double> > wrapper(strata, NC*NC, umintl::PROVIDED);
+    umintl::value_gradient tag(umintl::STOCHASTIC, sample_size, 0);
+    wrapper.compute_value_gradient(W.data(), value, grad, tag);
+    uint64_t all = wrapper.n_datapoints_accessed();
+    NEO_ICA_CHECK(!wrapper.compute_value_gradient(W.data(), value, grad, tag, value - 10));
+    uint64_t read = wrapper.n_datapoints_accessed() - all;
+    NEO_ICA_CHECK(read > 0 && read < all);
+}
+
+/* Coreset by sensitivity sampling : distinct frames, of at most NF, strata standing for their share of the NF
+ * frames, hence weights summing to NF over the strata that keep frames, and weighted estimates within the sampling
+ * error of the coreset size */
+void check_coreset(uint64_t & state){
+    test_data d(6, 20000, state);
+    double const fractions[] = {0.05, 0.2, 1};
+    for(double fraction : fractions){
+        std::vector<int64_t> indices, begin;
+        std::vector<double> weights;
+        sensitivity_sample(d.data, fraction, indices, begin, weights);
+        NEO_ICA_CHECK(begin.size()==weights.size() + 1 && begin.front()==0 && begin.back()==(int64_t)indices.size());
+        double total = 0;
+        for(size_t s = 0 ; s < weights.size() ; ++s){
+            NEO_ICA_CHECK(begin[s] <= begin[s + 1]);
+            if(begin[s + 1] > begin[s])
+                total += weights[s]*d.NF;
+        }
+        NEO_ICA_CHECK(std::abs(total - d.NF) < 1e-6);
+        std::vector<int64_t> sorted = indices;
+        std::sort(sorted.begin(), sorted.end());
+        NEO_ICA_CHECK(!sorted.empty() && sorted.front() >= 0 && sorted.back() < d.NF);
+        NEO_ICA_CHECK(std::adjacent_find(sorted.begin(), sorted.end())==sorted.end());
+
+        //The weighted strata estimate the value and gradient over all the frames
+        test_data core(d, indices);
+        int64_t NC = d.NC, M = core.NF;
+        std::unique_ptr<log_likelihood<double>> objective(d.objective(false)), core_objective(core.objective(false));
+        stratified_objective<double> strata(*core_objective, NC, M);
+        strata.assign(begin, weights);
+        std::vector<double> grad_(NC*NC), expected_(NC*NC);
+        double * grad = grad_.data(), * expected = expected_.data(), value, expected_value;
+        //Sampling error of M frames, the largest seen being ~2/sqrt(M)
+        double tolerance = 6/std::sqrt((double)M);
+        for(int trial = 0 ; trial < 4 ; ++trial){
+            std::vector<double> W = d.parameters(state);
+            (*objective)(W.data(), expected_value, expected, umintl::value_gradient(umintl::DETERMINISTIC, d.NF, 0));
+            strata(W.data(), value, grad, umintl::value_gradient(umintl::STOCHASTIC, M, 0));
+            NEO_ICA_CHECK(std::abs(value - expected_value) < tolerance);
+            NEO_ICA_CHECK(max_abs_diff(NC*NC, grad, expected) < tolerance);
+        }
+    }
+}
+
+int main(){
+    uint64_t state = 1;
+    test_data d(6, 5000, state);
+    check_curvature_cache(d, state);
+    check_early_exit(state);
+    check_strata(state);
+    check_stratified_early_exit(state);
+    check_coreset(state);
+    return test_result("objective");
+}
@@ -0,0 +1,45 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <atomic>
+#include <stdexcept>
+
+#include "test-utils.hpp"
+#include "neo_ica/tools/parallel.h"
+
+using namespace neo_ica::tools;
+
+//A region whose caller share throws still joins the workers and leaves the pool usable
+int main(){
+    thread_pool & pool = thread_pool::get();
+    pool.resize(4);
+    std::atomic<int> workers(0);
+    bool thrown = false;
+    try{
+        pool.run([&](int tid, int){
+            if(tid==0)
+                throw std::runtime_error("caller");
+            workers.fetch_add(1);
+        });
+    }
+    catch(std::runtime_error const &){
+        thrown = true;
+    }
+    NEO_ICA_CHECK(thrown);
+    NEO_ICA_CHECK(workers.load()==3);
+    NEO_ICA_CHECK(!thread_pool::in_parallel_region());
+
+    std::atomic<int> calls(0);
+    pool.run([&](int, int nthreads){
+        NEO_ICA_CHECK(nthreads==4);
+        calls.fetch_add(1);
+    });
+    NEO_ICA_CHECK(calls.load()==4);
+    return test_result("parallel");
+}
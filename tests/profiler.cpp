@@ -0,0 +1,39 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <chrono>
+#include <thread>
+
+#include "test-utils.hpp"
+#include "neo_ica/tools/profiler.h"
+
+using namespace neo_ica::tools;
+
+//A kernel nested in another one counts in the inclusive time of both, and in the self time of the inner one only
+int main(){
+    profiler & prof = profiler::get();
+    prof.enable(true);
+    {
+        scoped_phase outer(PHASE_REDUCTION);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        {
+            scoped_phase inner(PHASE_GEMM);
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        }
+    }
+    prof.enable(false);
+
+    phase_counters const & outer = prof[PHASE_REDUCTION];
+    phase_counters const & inner = prof[PHASE_GEMM];
+    NEO_ICA_CHECK(outer.calls==1 && inner.calls==1);
+    NEO_ICA_CHECK(inner.self_nanoseconds==inner.nanoseconds);
+    NEO_ICA_CHECK(outer.nanoseconds >= inner.nanoseconds);
+    NEO_ICA_CHECK(outer.self_nanoseconds==outer.nanoseconds - inner.nanoseconds);
+    return test_result("profiler");
+}
@@ -0,0 +1,45 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <vector>
+
+#include "test-utils.hpp"
+#include "neo_ica/backend/backend.hpp"
+#include "neo_ica/tools/reduction.hpp"
+
+using namespace neo_ica;
+
+/* tall_skinny_product against one GEMM, over windows of the rows that start at 0, in the middle of the
+ * range of a worker, and that lie within the range of one worker (one GEMM on the calling thread) */
+int main(){
+    const int64_t M = 6, N = 5, NF = 40000;
+    uint64_t state = 1;
+    std::vector<double> A(M*NF), B(N*NF), C(M*N), expected(M*N), initial(M*N);
+    for(int64_t i = 0 ; i < M*NF ; ++i)
+        A[i] = test_uniform(state);
+    for(int64_t i = 0 ; i < N*NF ; ++i)
+        B[i] = test_uniform(state);
+    for(int64_t i = 0 ; i < M*N ; ++i)
+        initial[i] = test_uniform(state);
+
+    int64_t const windows[][2] = {{0, NF}, {12345, 20000}, {3, 9000}, {NF - 8200, 8200}, {100, 50}};
+    int const pools[] = {1, 3, 4};
+    for(int nthreads : pools){
+        tools::thread_pool::get().resize(nthreads);
+        for(auto const & w : windows){
+            int64_t offset = w[0], n = w[1];
+            C = initial;
+            expected = initial;
+            backend<double>::gemm(Trans,NoTrans,M,N,n,0.5,A.data() + offset,NF,B.data() + offset,NF,2,expected.data(),M);
+            tools::tall_skinny_product(M,N,n,0.5,A.data() + offset,NF,B.data() + offset,NF,2.,C.data(),offset);
+            NEO_ICA_CHECK(max_abs_diff(M*N, C.data(), expected.data()) < 1e-10);
+        }
+    }
+    return test_result("reduction");
+}
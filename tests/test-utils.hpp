@@ -0,0 +1,55 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#ifndef NEO_ICA_TESTS_TEST_UTILS_HPP_
+#define NEO_ICA_TESTS_TEST_UTILS_HPP_
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdint.h>
+
+/*
+ * Minimal checks for the unit tests : each failed check is reported on stderr, and the test returns
+ * the number of failures
+ */
+
+static int test_failures = 0;
+
+#define NEO_ICA_CHECK(cond) neo_ica_check((cond), #cond, __FILE__, __LINE__)
+
+inline void neo_ica_check(bool cond, char const * what, char const * file, int line){
+    if(!cond){
+        std::cerr << file << ":" << line << ": check failed : " << what << std::endl;
+        ++test_failures;
+    }
+}
+
+//Largest absolute difference between a and b, of size n
+template<class T, class U>
+double max_abs_diff(int64_t n, T const * a, U const * b){
+    double res = 0;
+    for(int64_t i = 0 ; i < n ; ++i)
+        res = std::max(res, std::fabs((double)a[i] - (double)b[i]));
+    return res;
+}
+
+//Uniform in [-1, 1), reproducible across platforms
+inline double test_uniform(uint64_t & state){
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return (double)(state >> 11)/(double)(1ULL << 52) - 1;
+}
+
+inline int test_result(char const * name){
+    if(test_failures==0)
+        std::cout << name << " : passed" << std::endl;
+    return test_failures==0?EXIT_SUCCESS:EXIT_FAILURE;
+}
+
+#endif
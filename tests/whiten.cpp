@@ -0,0 +1,45 @@
+/* ===========================
+ *
+ * Copyright (c) 2013 Philippe Tillet - National Chiao Tung University
+ *
+ * NEO-ICA - Dynamically Sampled Hessian Free Independent Comopnent Analaysis
+ *
+ * License : MIT X11 - See the LICENSE file in the root folder
+ * ===========================*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "test-utils.hpp"
+#include "neo_ica/tools/whiten.hpp"
+
+/* whiten() on a frame count that is not a multiple of 4 : the mean is taken over the first NF frames at the
+ * stride of the data, and the data is restored on every frame */
+int main(){
+    const int64_t NC = 5, DataNF = 1003, NF = 1000;
+    uint64_t state = 1;
+    std::vector<double> data(NC*DataNF), original, sphere(NC*NC), white(NC*NF);
+    for(int64_t c = 0 ; c < NC ; ++c)
+        for(int64_t f = 0 ; f < DataNF ; ++f)
+            data[c*DataNF + f] = 3*c + 1 + test_uniform(state) + 0.5*test_uniform(state)*(c > 0?data[f]:0);
+    original = data;
+
+    neo_ica::whiten<double>(NC, DataNF, NF, data.data(), sphere.data(), white.data());
+
+    NEO_ICA_CHECK(max_abs_diff(NC*DataNF, data.data(), original.data()) < 1e-12);
+    for(int64_t c = 0 ; c < NC ; ++c){
+        double mean = 0;
+        for(int64_t f = 0 ; f < NF ; ++f)
+            mean += white[c*NF + f]/NF;
+        NEO_ICA_CHECK(std::fabs(mean) < 1e-10);
+    }
+    for(int64_t i = 0 ; i < NC ; ++i)
+        for(int64_t j = 0 ; j < NC ; ++j){
+            double cov = 0;
+            for(int64_t f = 0 ; f < NF ; ++f)
+                cov += white[i*NF + f]*white[j*NF + f]/(NF - 1);
+            NEO_ICA_CHECK(std::fabs(cov - (i==j)) < 2e-2);
+        }
+    return test_result("whiten");
+}